@@ -23,9 +23,12 @@
 #include "tea_func.c"
 #include "tea_string.c"
 #include "tea_map.c"
+#include "tea_set.c"
 #include "tea_object.c"
 #include "tea_scanner.c"
 #include "tea_state.c"
+#include "tea_strfmt.c"
+#include "tea_strscan.c"
 #include "tea_table.c"
 #include "tea_utf.c"
 #include "tea_util.c"
@@ -35,6 +38,9 @@
 #include "tea_fileclass.c"
 #include "tea_listclass.c"
 #include "tea_mapclass.c"
+#include "tea_setclass.c"
+#include "tea_iterclass.c"
+#include "tea_bufferclass.c"
 #include "tea_rangeclass.c"
 #include "tea_stringclass.c"
 #include "tea_iolib.c"
@@ -43,5 +49,9 @@
 #include "tea_mathlib.c"
 #include "tea_syslib.c"
 #include "tea_timelib.c"
+#include "tea_eventlib.c"
+#include "tea_socketlib.c"
+#include "tea_jsonlib.c"
+#include "tea_csvlib.c"
 
 #include "tea.c"
\ No newline at end of file
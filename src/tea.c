@@ -194,9 +194,13 @@ int main(int argc, char** argv)
     if(flags & flag_v)
         print_version();
     if((status = run_args(T, argv, script)) > 1)
+    {
+        tea_close(T);
         return status; 
+    }
     if(script < argc && (status = handle_script(T, argv + script)) != TEA_OK)
     {
+        tea_close(T);
         return status;
     }
     if(flags & flag_i)
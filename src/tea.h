@@ -71,6 +71,9 @@ typedef enum
     TEA_TYPE_INSTANCE,
     TEA_TYPE_LIST,
     TEA_TYPE_MAP,
+    TEA_TYPE_SET,
+    TEA_TYPE_ITERATOR,
+    TEA_TYPE_BUFFER,
     TEA_TYPE_FILE,
     TEA_TYPE_USERDATA,
 } TeaType;
@@ -108,6 +111,7 @@ TEA_API double tea_to_numberx(TeaState* T, int index, int* is_num);
 TEA_API const char* tea_to_lstring(TeaState* T, int index, int* len);
 TEA_API TeaCFunction tea_to_cfunction(TeaState* T, int index);
 TEA_API void* tea_to_userdata(TeaState* T, int index);
+TEA_API void* tea_to_buffer(TeaState* T, int index, int* len);
 
 TEA_API int tea_equals(TeaState* T, int index1, int index2);
 
@@ -127,7 +131,9 @@ TEA_API void tea_push_cfunction(TeaState* T, TeaCFunction fn);
 
 TEA_API void tea_new_list(TeaState* T);
 TEA_API void tea_new_map(TeaState* T);
+TEA_API void tea_new_set(TeaState* T);
 TEA_API void* tea_new_userdata(TeaState* T, size_t size);
+TEA_API void* tea_new_buffer(TeaState* T, int len);
 
 TEA_API void tea_create_class(TeaState* T, const char* name, const TeaClass* klass);
 TEA_API void tea_create_module(TeaState* T, const char* name, const TeaModule* module);
@@ -187,6 +193,8 @@ TEA_API void tea_error(TeaState* T, const char* fmt, ...);
 #define tea_check_list(T, index) (tea_check_type(T, index, TEA_TYPE_LIST))
 #define tea_check_function(T, index) (tea_check_type(T, index, TEA_TYPE_FUNCTION))
 #define tea_check_map(T, index) (tea_check_type(T, index, TEA_TYPE_MAP))
+#define tea_check_set(T, index) (tea_check_type(T, index, TEA_TYPE_SET))
+#define tea_check_buffer(T, index) (tea_check_type(T, index, TEA_TYPE_BUFFER))
 #define tea_check_file(T, index) (tea_check_type(T, index, TEA_TYPE_FILE))
 
 #define tea_check_args(T, cond, msg, ...) if(cond) tea_error(T, (msg), __VA_ARGS__)
@@ -204,6 +212,8 @@ TEA_API void tea_error(TeaState* T, const char* fmt, ...);
 #define tea_is_string(T, n) (tea_type(T, (n)) == TEA_TYPE_STRING)
 #define tea_is_list(T, n) (tea_type(T, (n)) == TEA_TYPE_LIST)
 #define tea_is_map(T, n) (tea_type(T, (n)) == TEA_TYPE_MAP)
+#define tea_is_set(T, n) (tea_type(T, (n)) == TEA_TYPE_SET)
+#define tea_is_buffer(T, n) (tea_type(T, (n)) == TEA_TYPE_BUFFER)
 #define tea_is_function(T, n) (tea_type(T, (n)) == TEA_TYPE_FUNCTION)
 #define tea_is_file(T, n) (tea_type(T, (n)) == TEA_TYPE_FILE)
 #define tea_is_userdata(T, n) (tea_type(T, (n)) == TEA_TYPE_USERDATA)
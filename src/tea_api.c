@@ -12,6 +12,7 @@
 #include "tea_string.h"
 #include "tea_func.h"
 #include "tea_map.h"
+#include "tea_set.h"
 #include "tea_vm.h"
 #include "tea_do.h"
 #include "tea_util.h"
@@ -47,6 +48,11 @@ static TeaValue* index2stack(TeaState* T, int index)
 TEA_API void tea_set_repl(TeaState* T, bool b)
 {
     T->repl = b;
+    if(b)
+    {
+        /* Results show up before the next prompt */
+        T->out_mode = OUT_LINE;
+    }
 }
 
 TEA_API void tea_set_argv(TeaState* T, int argc, char** argv, int argf)
@@ -156,6 +162,12 @@ TEA_API int tea_type(TeaState* T, int index)
                 return TEA_TYPE_FUNCTION;
             case OBJ_MAP:
                 return TEA_TYPE_MAP;
+            case OBJ_SET:
+                return TEA_TYPE_SET;
+            case OBJ_ITERATOR:
+                return TEA_TYPE_ITERATOR;
+            case OBJ_BUFFER:
+                return TEA_TYPE_BUFFER;
             case OBJ_STRING:
                 return TEA_TYPE_STRING;
             case OBJ_FILE:
@@ -263,6 +275,21 @@ TEA_API void* tea_to_userdata(TeaState* T, int index)
     return data;
 }
 
+TEA_API void* tea_to_buffer(TeaState* T, int index, int* len)
+{
+    TeaValue v = index2value(T, index);
+    if(!IS_BUFFER(v))
+    {
+        if(len != NULL)
+            *len = 0;
+        return NULL;
+    }
+
+    if(len != NULL)
+        *len = AS_BUFFER(v)->length;
+    return tea_obj_buffer_bytes(T, AS_BUFFER(v));
+}
+
 TEA_API int tea_equals(TeaState* T, int index1, int index2)
 {
     return tea_value_equal(index2value(T, index1), index2value(T, index2));
@@ -300,7 +327,13 @@ TEA_API void tea_push_number(TeaState* T, double n)
 
 TEA_API const char* tea_push_lstring(TeaState* T, const char* s, int len)
 {
-    TeaObjectString* string = (len == 0) ? tea_string_literal(T, "") : tea_string_copy(T, s, len);
+    TeaObjectString* string;
+    if(len == 0)
+        string = tea_string_literal(T, "");
+    else if(len == 1)
+        string = tea_string_char(T, s[0]);
+    else
+        string = tea_string_copy(T, s, len);
     tea_vm_push(T, OBJECT_VAL(string));
 
     return string->chars;
@@ -363,6 +396,11 @@ TEA_API void tea_new_map(TeaState* T)
     tea_vm_push(T, OBJECT_VAL(tea_map_new(T)));
 }
 
+TEA_API void tea_new_set(TeaState* T)
+{
+    tea_vm_push(T, OBJECT_VAL(tea_set_new(T)));
+}
+
 TEA_API void* tea_new_userdata(TeaState* T, size_t size)
 {
     TeaObjectUserdata* ud = tea_obj_new_userdata(T, size);
@@ -371,13 +409,20 @@ TEA_API void* tea_new_userdata(TeaState* T, size_t size)
     return ud->data;
 }
 
+TEA_API void* tea_new_buffer(TeaState* T, int len)
+{
+    TeaObjectBuffer* buffer = tea_obj_new_buffer(T, len);
+    tea_vm_push(T, OBJECT_VAL(buffer));
+    return buffer->bytes;
+}
+
 TEA_API void tea_push_cfunction(TeaState* T, TeaCFunction fn)
 {
     TeaObjectNative* native = tea_func_new_native(T, NATIVE_FUNCTION, fn);
     tea_vm_push(T, OBJECT_VAL(native));
 }
 
-static void set_class(TeaState* T, const TeaClass* k)
+static void add_methods(TeaState* T, const TeaClass* k)
 {
     for(; k->name != NULL; k++)
     {
@@ -405,7 +450,7 @@ TEA_API void tea_create_class(TeaState* T, const char* name, const TeaClass* kla
     tea_vm_push(T, OBJECT_VAL(tea_obj_new_class(T, tea_string_new(T, name), NULL)));
     if(klass != NULL)
     {
-        set_class(T, klass);
+        add_methods(T, klass);
     }
 }
 
@@ -458,6 +503,14 @@ TEA_API int tea_len(TeaState* T, int index)
             {
                 return AS_MAP(object)->count;
             }
+            case OBJ_SET:
+            {
+                return AS_SET(object)->count;
+            }
+            case OBJ_BUFFER:
+            {
+                return AS_BUFFER(object)->length;
+            }
             default:;
         }
     }
@@ -788,9 +841,8 @@ TEA_API void tea_error(TeaState* T, const char* fmt, ...)
     va_start(args, fmt);
 
     char msg[1024];
-    int len = vsnprintf(NULL, 0, fmt, args);
-    vsnprintf(msg, len + 1, fmt, args);
+    vsnprintf(msg, sizeof(msg), fmt, args);
     va_end(args);
 
-    tea_vm_error(T, msg);
+    tea_vm_error(T, "%s", msg);
 }
\ No newline at end of file
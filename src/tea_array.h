@@ -6,6 +6,8 @@
 #ifndef TEA_ARRAY_H
 #define TEA_ARRAY_H
 
+#include <string.h>
+
 #include "tea_def.h"
 #include "tea_value.h"
 
@@ -14,12 +16,17 @@
     { \
 		int capacity; \
 		int count; \
+		int front; /* Free slots before values, capacity counts from values */ \
 		type* values; \
 	} name; \
     \
 	void tea_init_##shr(name* array); \
 	void tea_write_##shr(TeaState* T, name* array, type value); \
+	void tea_reserve_##shr(TeaState* T, name* array, int capacity); \
 	void tea_fill_##shr(TeaState* T, name* array, type value, int count); \
+	void tea_append_##shr(TeaState* T, name* array, name* from); \
+	void tea_unshift_##shr(TeaState* T, name* array, type value); \
+	void tea_shift_##shr(name* array); \
 	void tea_free_##shr(TeaState* T, name* array);
 
 #define DEFINE_ARRAY(name, type, shr) \
@@ -28,15 +35,40 @@
 		array->values = NULL; \
 		array->capacity = 0; \
 		array->count = 0; \
+		array->front = 0; \
+	} \
+	void tea_reserve_##shr(TeaState* T, name* array, int capacity) \
+	{ \
+		if(array->capacity >= capacity) \
+			return; \
+		type* base = TEA_GROW_ARRAY(T, type, array->values - array->front, array->capacity + array->front, capacity + array->front); \
+		array->values = base + array->front; \
+		array->capacity = capacity; \
+	} \
+	static inline void tea_grow_##shr(TeaState* T, name* array, int count) \
+	{ \
+		if(array->capacity >= array->count + count) \
+			return; \
+		/* Slide back over the front gap once it outgrows the values */ \
+		if(array->front > 0 && array->front >= array->count) \
+		{ \
+			type* base = array->values - array->front; \
+			memmove(base, array->values, sizeof(type) * array->count); \
+			array->values = base; \
+			array->capacity += array->front; \
+			array->front = 0; \
+			if(array->capacity >= array->count + count) \
+				return; \
+		} \
+		/* Size once for the whole batch */ \
+		int capacity = TEA_GROW_CAPACITY(array->capacity); \
+		if(capacity < array->count + count) \
+			capacity = array->count + count; \
+		tea_reserve_##shr(T, array, capacity); \
 	} \
 	void tea_fill_##shr(TeaState* T, name* array, type value, int count) \
     { \
-		if(array->capacity < array->count + count) \
-        { \
-			int old_capacity = array->capacity; \
-			array->capacity = TEA_GROW_CAPACITY(old_capacity); \
-			array->values = TEA_GROW_ARRAY(T, type, array->values, old_capacity, array->capacity); \
-		} \
+		tea_grow_##shr(T, array, count); \
 		\
 		for(int i = 0; i < count; i++) \
 		{ \
@@ -47,9 +79,50 @@
 	{ \
 		tea_fill_##shr(T, array, value, 1); \
 	} \
+	void tea_append_##shr(TeaState* T, name* array, name* from) \
+	{ \
+		int count = from->count; \
+		tea_grow_##shr(T, array, count); \
+		/* from may be array itself, so read its values after growing */ \
+		if(count > 0) \
+			memcpy(array->values + array->count, from->values, sizeof(type) * count); \
+		array->count += count; \
+	} \
+	void tea_unshift_##shr(TeaState* T, name* array, type value) \
+	{ \
+		if(array->front == 0) \
+		{ \
+			/* Open a gap as large as the array so unshifts stay amortized O(1) */ \
+			int gap = array->count < 8 ? 8 : array->count; \
+			type* base = TEA_ALLOCATE(T, type, gap + array->capacity); \
+			if(array->count > 0) \
+				memcpy(base + gap, array->values, sizeof(type) * array->count); \
+			TEA_FREE_ARRAY(T, type, array->values, array->capacity); \
+			array->values = base + gap; \
+			array->front = gap; \
+		} \
+		array->values--; \
+		array->front--; \
+		array->capacity++; \
+		array->count++; \
+		array->values[0] = value; \
+	} \
+	void tea_shift_##shr(name* array) \
+	{ \
+		array->values++; \
+		array->front++; \
+		array->capacity--; \
+		array->count--; \
+		if(array->count == 0) \
+		{ \
+			array->values -= array->front; \
+			array->capacity += array->front; \
+			array->front = 0; \
+		} \
+	} \
 	void tea_free_##shr(TeaState* T, name* array) \
     { \
-		TEA_FREE_ARRAY(T, type, array->values, array->capacity); \
+		TEA_FREE_ARRAY(T, type, array->values - array->front, array->capacity + array->front); \
 		tea_init_##shr(array); \
 	}
 
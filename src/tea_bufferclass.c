@@ -0,0 +1,355 @@
+/*
+** tea_bufferclass.c
+** Teascript buffer class
+*/
+
+#include <string.h>
+#include <limits.h>
+
+#define tea_bufferclass_c
+#define TEA_CORE
+
+#include "tea_vm.h"
+#include "tea_core.h"
+#include "tea_memory.h"
+
+static int check_length(TeaState* T, int index)
+{
+    double n = tea_check_number(T, index);
+    if(n < 0 || n > INT_MAX)
+    {
+        tea_error(T, "Expected a size from 0 to %d", INT_MAX);
+    }
+    return (int)n;
+}
+
+/* Clamps an index into [0, length], negative indexes count from the end */
+static int clamp_index(TeaState* T, int index, int length)
+{
+    double i = tea_check_number(T, index);
+    if(i < 0)
+        i += length;
+    if(i < 0)
+        return 0;
+    return i > length ? length : (int)i;
+}
+
+static void buffer_constructor(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count > 2, "Expected 0 or 1 argument, got %d", count - 1);
+
+    if(count == 1)
+    {
+        tea_new_buffer(T, 0);
+        return;
+    }
+
+    TeaValue from = T->base[1];
+    if(IS_NUMBER(from))
+    {
+        tea_new_buffer(T, check_length(T, 1));
+    }
+    else if(IS_STRING(from))
+    {
+        TeaObjectString* string = AS_STRING(from);
+        uint8_t* bytes = tea_new_buffer(T, string->length);
+        memcpy(bytes, string->chars, string->length);
+    }
+    else if(IS_BUFFER(from))
+    {
+        TeaObjectBuffer* other = AS_BUFFER(from);
+        uint8_t* bytes = tea_new_buffer(T, other->length);
+        memcpy(bytes, tea_obj_buffer_bytes(T, other), other->length);
+    }
+    else if(IS_LIST(from))
+    {
+        TeaObjectList* list = AS_LIST(from);
+        uint8_t* bytes = tea_new_buffer(T, list->items.count);
+        for(int i = 0; i < list->items.count; i++)
+        {
+            TeaValue item = list->items.values[i];
+            if(!IS_NUMBER(item) || AS_NUMBER(item) < 0 || AS_NUMBER(item) > 255)
+            {
+                tea_error(T, "Expected a list of bytes from 0 to 255");
+            }
+            bytes[i] = (uint8_t)AS_NUMBER(item);
+        }
+    }
+    else
+    {
+        tea_error(T, "Expected a size, string, buffer or list, got %s", tea_type_name(T, 1));
+    }
+}
+
+static void buffer_len(TeaState* T)
+{
+    tea_push_number(T, AS_BUFFER(T->base[0])->length);
+}
+
+static void buffer_resize(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+
+    TeaObjectBuffer* buffer = AS_BUFFER(T->base[0]);
+    int size = check_length(T, 1);
+    if(buffer->owner != NULL)
+    {
+        tea_error(T, "Cannot resize a buffer view");
+    }
+
+    tea_obj_buffer_resize(T, buffer, size);
+    tea_set_top(T, 1);
+}
+
+/* Views share the bytes of the buffer, nothing is copied */
+static void buffer_slice(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 3, "Expected 1 or 2 arguments, got %d", count - 1);
+
+    TeaObjectBuffer* buffer = AS_BUFFER(T->base[0]);
+    tea_obj_buffer_bytes(T, buffer);
+
+    int start = clamp_index(T, 1, buffer->length);
+    int end = count == 3 ? clamp_index(T, 2, buffer->length) : buffer->length;
+    if(end < start)
+        end = start;
+
+    TeaObjectBuffer* view = tea_obj_new_buffer_view(T, buffer, start, end - start);
+    tea_vm_push(T, OBJECT_VAL(view));
+}
+
+static void buffer_copy(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 0 arguments, got %d", count - 1);
+
+    TeaObjectBuffer* buffer = AS_BUFFER(T->base[0]);
+    uint8_t* bytes = tea_new_buffer(T, buffer->length);
+    memcpy(bytes, tea_obj_buffer_bytes(T, buffer), buffer->length);
+}
+
+static void buffer_fillbytes(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+
+    TeaObjectBuffer* buffer = AS_BUFFER(T->base[0]);
+    double byte = tea_check_number(T, 1);
+    if(byte < 0 || byte > 255)
+    {
+        tea_error(T, "Expected a byte from 0 to 255");
+    }
+
+    memset(tea_obj_buffer_bytes(T, buffer), (int)byte, buffer->length);
+    tea_set_top(T, 1);
+}
+
+/* Checks the offset and byte order arguments, returning where size bytes start */
+static uint8_t* check_offset(TeaState* T, int size, int order_index, bool* big)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < order_index || count > order_index + 1,
+        "Expected %d or %d arguments, got %d", order_index - 1, order_index, count - 1);
+
+    TeaObjectBuffer* buffer = AS_BUFFER(T->base[0]);
+    double offset = tea_check_number(T, 1);
+    if(offset < 0 || offset > (double)buffer->length - size)
+    {
+        tea_error(T, "Buffer offset out of bounds");
+    }
+
+    *big = tea_opt_bool(T, order_index, false);
+    return tea_obj_buffer_bytes(T, buffer) + (int)offset;
+}
+
+static uint64_t load(const uint8_t* p, int size, bool big)
+{
+    uint64_t v = 0;
+    if(big)
+    {
+        for(int i = 0; i < size; i++)
+            v = (v << 8) | p[i];
+    }
+    else
+    {
+        for(int i = size - 1; i >= 0; i--)
+            v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void store(uint8_t* p, int size, bool big, uint64_t v)
+{
+    for(int i = 0; i < size; i++)
+    {
+        p[big ? size - 1 - i : i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static double to_float32(uint64_t v)
+{
+    uint32_t u = (uint32_t)v;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static double to_float64(uint64_t v)
+{
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+static uint64_t from_float32(double d)
+{
+    float f = (float)d;
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static uint64_t from_float64(double d)
+{
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    return u;
+}
+
+/* get<type>(offset, big = false) reads a number, little endian unless big is true */
+#define BUFFER_GET(name, size, convert) \
+    static void buffer_get##name(TeaState* T) \
+    { \
+        bool big; \
+        uint8_t* p = check_offset(T, size, 2, &big); \
+        uint64_t v = load(p, size, big); \
+        tea_push_number(T, (double)(convert)); \
+    }
+
+/* put<type>(offset, value, big = false) writes a number and returns the offset after it */
+#define BUFFER_PUT(name, size, min, limit, encode) \
+    static void buffer_put##name(TeaState* T) \
+    { \
+        bool big; \
+        uint8_t* p = check_offset(T, size, 3, &big); \
+        double value = tea_check_number(T, 2); \
+        if(!(value >= (min) && value < (limit))) \
+        { \
+            tea_error(T, "Value out of range for " #name); \
+        } \
+        store(p, size, big, (encode)); \
+        tea_push_number(T, tea_get_number(T, 1) + size); \
+    }
+
+#define BUFFER_PUT_FLOAT(name, size, encode) \
+    static void buffer_put##name(TeaState* T) \
+    { \
+        bool big; \
+        uint8_t* p = check_offset(T, size, 3, &big); \
+        double value = tea_check_number(T, 2); \
+        store(p, size, big, (encode)); \
+        tea_push_number(T, tea_get_number(T, 1) + size); \
+    }
+
+BUFFER_GET(int8, 1, (int8_t)v)
+BUFFER_GET(uint8, 1, (uint8_t)v)
+BUFFER_GET(int16, 2, (int16_t)v)
+BUFFER_GET(uint16, 2, (uint16_t)v)
+BUFFER_GET(int32, 4, (int32_t)v)
+BUFFER_GET(uint32, 4, (uint32_t)v)
+BUFFER_GET(int64, 8, (int64_t)v)
+BUFFER_GET(uint64, 8, v)
+BUFFER_GET(float32, 4, to_float32(v))
+BUFFER_GET(float64, 8, to_float64(v))
+
+BUFFER_PUT(int8, 1, -128.0, 128.0, (uint64_t)(int64_t)value)
+BUFFER_PUT(uint8, 1, 0.0, 256.0, (uint64_t)value)
+BUFFER_PUT(int16, 2, -32768.0, 32768.0, (uint64_t)(int64_t)value)
+BUFFER_PUT(uint16, 2, 0.0, 65536.0, (uint64_t)value)
+BUFFER_PUT(int32, 4, -2147483648.0, 2147483648.0, (uint64_t)(int64_t)value)
+BUFFER_PUT(uint32, 4, 0.0, 4294967296.0, (uint64_t)value)
+BUFFER_PUT(int64, 8, -9223372036854775808.0, 9223372036854775808.0, (uint64_t)(int64_t)value)
+BUFFER_PUT(uint64, 8, 0.0, 18446744073709551616.0, (uint64_t)value)
+BUFFER_PUT_FLOAT(float32, 4, from_float32(value))
+BUFFER_PUT_FLOAT(float64, 8, from_float64(value))
+
+static void buffer_iterate(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    int len = AS_BUFFER(T->base[0])->length;
+    if(tea_is_null(T, 1))
+    {
+        if(len == 0)
+            tea_push_null(T);
+        else
+            tea_push_number(T, 0);
+        return;
+    }
+
+    int index = tea_check_number(T, 1);
+    if(index < 0 || index >= len - 1)
+    {
+        tea_push_null(T);
+        return;
+    }
+    tea_push_number(T, index + 1);
+}
+
+static void buffer_iteratorvalue(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    TeaObjectBuffer* buffer = AS_BUFFER(T->base[0]);
+    int index = tea_check_number(T, 1);
+    if(index < 0 || index >= buffer->length)
+    {
+        tea_error(T, "Invalid buffer iterator");
+    }
+    tea_push_number(T, tea_obj_buffer_bytes(T, buffer)[index]);
+}
+
+static const TeaClass buffer_class[] = {
+    { "constructor", "method", buffer_constructor },
+    { "len", "property", buffer_len },
+    { "resize", "method", buffer_resize },
+    { "slice", "method", buffer_slice },
+    { "copy", "method", buffer_copy },
+    { "fill", "method", buffer_fillbytes },
+    { "getint8", "method", buffer_getint8 },
+    { "getuint8", "method", buffer_getuint8 },
+    { "getint16", "method", buffer_getint16 },
+    { "getuint16", "method", buffer_getuint16 },
+    { "getint32", "method", buffer_getint32 },
+    { "getuint32", "method", buffer_getuint32 },
+    { "getint64", "method", buffer_getint64 },
+    { "getuint64", "method", buffer_getuint64 },
+    { "getfloat32", "method", buffer_getfloat32 },
+    { "getfloat64", "method", buffer_getfloat64 },
+    { "putint8", "method", buffer_putint8 },
+    { "putuint8", "method", buffer_putuint8 },
+    { "putint16", "method", buffer_putint16 },
+    { "putuint16", "method", buffer_putuint16 },
+    { "putint32", "method", buffer_putint32 },
+    { "putuint32", "method", buffer_putuint32 },
+    { "putint64", "method", buffer_putint64 },
+    { "putuint64", "method", buffer_putuint64 },
+    { "putfloat32", "method", buffer_putfloat32 },
+    { "putfloat64", "method", buffer_putfloat64 },
+    { "iterate", "method", buffer_iterate },
+    { "iteratorvalue", "method", buffer_iteratorvalue },
+    { NULL, NULL, NULL }
+};
+
+void tea_open_buffer(TeaState* T)
+{
+    tea_create_class(T, TEA_BUFFER_CLASS, buffer_class);
+    T->buffer_class = AS_CLASS(T->top[-1]);
+    tea_set_global(T, TEA_BUFFER_CLASS);
+    tea_push_null(T);
+}
@@ -23,25 +23,20 @@
 static void core_print(TeaState* T)
 {
     int count = tea_get_top(T);
-    if(count == 0)
-    {
-        putchar('\n');
-        tea_push_null(T);
-        return;
-    }
 
+    /* The whole line goes into the output buffer, so it is written at once */
     for(int i = 0; i < count; i++)
     {
         int len;
         const char* string = tea_to_lstring(T, i, &len);
         if(i)
-            putchar('\t');
+            tea_state_write(T, "\t", 1);
 
-        fwrite(string, sizeof(char), len, stdout);
+        tea_state_write(T, string, len);
         tea_pop(T, 1);
     }
 
-    putchar('\n');
+    tea_state_write(T, "\n", 1);
     tea_push_null(T);
 }
 
@@ -53,35 +48,15 @@ static void core_input(TeaState* T)
     {
         int len;
         const char* prompt = tea_check_lstring(T, 0, &len);
-        fwrite(prompt, sizeof(char), len, stdout);
-    }
-
-    uint64_t current_size = 128;
-    char* line = TEA_ALLOCATE(T, char, current_size);
-
-    int c = EOF;
-    uint64_t length = 0;
-    while((c = getchar()) != '\n' && c != EOF) 
-    {
-        line[length++] = (char)c;
-
-        if(length + 1 == current_size) 
-        {
-            int old_size = current_size;
-            current_size = TEA_GROW_CAPACITY(current_size);
-            line = TEA_GROW_ARRAY(T, char, line, old_size, current_size);
-        }
+        tea_state_write(T, prompt, len);
     }
+    tea_state_flush(T);
 
-    /* If length has changed, shrink */
-    if(length != current_size) 
+    /* Lines come from the same buffer as io.stdin */
+    if(!tea_file_readline(T, tea_file_stdin(T)))
     {
-        line = TEA_GROW_ARRAY(T, char, line, current_size, length + 1);
+        tea_push_lstring(T, "", 0);
     }
-    
-    line[length] = '\0';
-
-    tea_vm_push(T, OBJECT_VAL(tea_string_take(T, line, length)));
 }
 
 static void core_open(TeaState* T)
@@ -95,7 +70,10 @@ static void core_open(TeaState* T)
     if(count == 2)
         type = tea_check_string(T, 1);
 
-    FILE* fp = fopen(path, type);
+    /* "m" maps the file into memory read only */
+    bool mapped = strcmp(type, "m") == 0;
+
+    FILE* fp = fopen(path, mapped ? "r" : type);
     if(fp == NULL) 
     {
         tea_error(T, "Unable to open file '%s'", path);
@@ -105,6 +83,10 @@ static void core_open(TeaState* T)
     file->file = fp;
 
     tea_vm_push(T, OBJECT_VAL(file));
+    if(mapped)
+    {
+        tea_file_map(T, file);
+    }
 }
 
 static void core_assert(TeaState* T)
@@ -265,7 +247,7 @@ static void tea_open_global(TeaState* T)
 
 void tea_open_core(TeaState* T)
 {
-    const TeaCFunction core[] = { tea_open_global, tea_open_file, tea_open_list, tea_open_map, tea_open_string, tea_open_range, NULL };
+    const TeaCFunction core[] = { tea_open_global, tea_open_file, tea_open_list, tea_open_map, tea_open_set, tea_open_iter, tea_open_buffer, tea_open_string, tea_open_range, NULL };
 
     for(int i = 0; core[i] != NULL; i++)
     {
@@ -10,6 +10,14 @@
 
 #define TEA_FILE_CLASS "file"
 void tea_open_file(TeaState* T);
+void tea_file_map(TeaState* T, TeaObjectFile* file);
+void tea_file_unmap(TeaObjectFile* file);
+size_t tea_file_fill(TeaState* T, TeaObjectFile* file);
+bool tea_file_readline(TeaState* T, TeaObjectFile* file);
+size_t tea_file_write(TeaState* T, TeaObjectFile* file, const char* chars, size_t len, bool newline);
+bool tea_file_hold_sigpipe(void);
+void tea_file_release_sigpipe(bool held);
+TeaObjectFile* tea_file_stdin(TeaState* T);
 
 #define TEA_LIST_CLASS "list"
 void tea_open_list(TeaState* T);
@@ -17,6 +25,15 @@ void tea_open_list(TeaState* T);
 #define TEA_MAP_CLASS "map"
 void tea_open_map(TeaState* T);
 
+#define TEA_SET_CLASS "set"
+void tea_open_set(TeaState* T);
+
+#define TEA_ITER_CLASS "iter"
+void tea_open_iter(TeaState* T);
+
+#define TEA_BUFFER_CLASS "buffer"
+void tea_open_buffer(TeaState* T);
+
 #define TEA_STRING_CLASS "string"
 void tea_open_string(TeaState* T);
 
@@ -25,4 +42,9 @@ void tea_open_range(TeaState* T);
 
 void tea_open_core(TeaState* T);
 
+/* Roots and cleanup for the event module */
+void tea_event_mark(TeaState* T);
+void tea_event_close(TeaState* T);
+void tea_event_forget(TeaState* T, int fd);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,793 @@
+/*
+** tea_csvlib.c
+** Teascript csv module
+**
+** Rows are parsed straight out of a string, a mapped file or a file's read
+** ahead buffer, each field becomes a string or number from its span of the
+** input without being copied anywhere first
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define tea_csvlib_c
+#define TEA_LIB
+
+#include "tea.h"
+#include "tealib.h"
+
+#include "tea_import.h"
+#include "tea_core.h"
+#include "tea_state.h"
+#include "tea_string.h"
+#include "tea_memory.h"
+#include "tea_map.h"
+#include "tea_table.h"
+#include "tea_vm.h"
+#include "tea_do.h"
+#include "tea_strscan.h"
+#include "tea_strfmt.h"
+
+/* Formatted output is handed to the file once it grows past this */
+#define CSV_FLUSH_SIZE 65536
+
+typedef enum
+{
+    CSV_ROW,
+    CSV_END,
+    CSV_MORE,   /* The buffered input ends inside the row */
+    CSV_ERROR   /* The row is malformed, see error and error_offset */
+} CsvStatus;
+
+typedef struct
+{
+    char delimiter;
+    char quote;
+    TeaValue numbers;   /* true, or a list of the columns to convert */
+} CsvOptions;
+
+typedef struct
+{
+    TeaState* T;
+    const char* start;
+    const char* p;
+    const char* end;
+    bool more;          /* The input may continue past end */
+    CsvOptions* options;
+    char* chars;        /* Scratch space for quoted fields with doubled quotes */
+    int chars_size;
+    const char* error;
+    int error_offset;
+} CsvParser;
+
+static char csv_char_option(TeaState* T, TeaObjectMap* map, const char* name, char def)
+{
+    TeaValue value;
+    if(!tea_map_get(map, OBJECT_VAL(tea_string_new(T, name)), &value) || IS_NULL(value))
+        return def;
+
+    if(!IS_STRING(value) || AS_STRING(value)->length != 1)
+    {
+        tea_error(T, "Expected %s to be a single character", name);
+    }
+    return AS_CSTRING(value)[0];
+}
+
+/* Reads the delimiter, quote and numbers options from a map at index */
+static void csv_options(TeaState* T, int index, CsvOptions* options)
+{
+    options->delimiter = ',';
+    options->quote = '"';
+    options->numbers = FALSE_VAL;
+
+    if(tea_is_nonenull(T, index))
+        return;
+
+    tea_check_map(T, index);
+    TeaObjectMap* map = AS_MAP(T->base[index]);
+    options->delimiter = csv_char_option(T, map, "delimiter", ',');
+    options->quote = csv_char_option(T, map, "quote", '"');
+
+    TeaValue numbers;
+    if(tea_map_get(map, OBJECT_VAL(tea_string_literal(T, "numbers")), &numbers))
+    {
+        if(!IS_BOOL(numbers) && !IS_LIST(numbers) && !IS_NULL(numbers))
+        {
+            tea_error(T, "Expected numbers to be a bool or a list of columns");
+        }
+        options->numbers = numbers;
+    }
+
+    if(options->delimiter == options->quote || options->delimiter == '\n' || options->delimiter == '\r')
+    {
+        tea_error(T, "Invalid delimiter");
+    }
+}
+
+static bool csv_number_column(CsvOptions* options, int column)
+{
+    TeaValue numbers = options->numbers;
+    if(IS_BOOL(numbers))
+        return AS_BOOL(numbers);
+    if(!IS_LIST(numbers))
+        return false;
+
+    TeaValueArray* columns = &AS_LIST(numbers)->items;
+    for(int i = 0; i < columns->count; i++)
+    {
+        if(IS_NUMBER(columns->values[i]) && AS_NUMBER(columns->values[i]) == column)
+            return true;
+    }
+    return false;
+}
+
+static void csv_reserve(CsvParser* ps, int len, int more)
+{
+    if(len + more > ps->chars_size)
+    {
+        int old_size = ps->chars_size;
+        int new_size = old_size < 64 ? 64 : old_size;
+        while(new_size < len + more)
+            new_size *= 2;
+        ps->chars = TEA_GROW_ARRAY(ps->T, char, ps->chars, old_size, new_size);
+        ps->chars_size = new_size;
+    }
+}
+
+/*
+** Pushes the next row as a list. Unquoted fields in number columns become
+** numbers when they read as one and null when empty, everything else is a
+** string. Quoted fields always stay strings
+*/
+static CsvStatus csv_parse_row(CsvParser* ps)
+{
+    TeaState* T = ps->T;
+    CsvOptions* options = ps->options;
+    const char* end = ps->end;
+    const char* p = ps->p;
+
+    if(p >= end)
+        return ps->more ? CSV_MORE : CSV_END;
+
+    TeaObjectList* row = tea_obj_new_list(T);
+    tea_vm_push(T, OBJECT_VAL(row));
+
+    /* A blank line is a row without fields */
+    if(*p == '\n' || *p == '\r')
+        goto row_end;
+
+    for(int column = 0; ; column++)
+    {
+        TeaValue field;
+        if(*p == options->quote)
+        {
+            const char* start = ++p;
+            int len = 0;
+            bool escaped = false;
+            while(true)
+            {
+                const char* close = memchr(p, options->quote, end - p);
+                if(close == NULL || close + 1 >= end)
+                {
+                    /* The closing quote, or what follows it, is not here yet */
+                    if(ps->more)
+                        return CSV_MORE;
+                    if(close == NULL)
+                    {
+                        ps->error = "Unterminated quoted field";
+                        ps->error_offset = start - 1 - ps->start;
+                        return CSV_ERROR;
+                    }
+                }
+
+                if(close + 1 < end && close[1] == options->quote)
+                {
+                    /* A doubled quote stands for one, collect the field in pieces */
+                    csv_reserve(ps, len, close - p + 1);
+                    memcpy(ps->chars + len, p, close - p + 1);
+                    len += close - p + 1;
+                    escaped = true;
+                    p = close + 2;
+                    continue;
+                }
+
+                if(escaped)
+                {
+                    csv_reserve(ps, len, close - p);
+                    memcpy(ps->chars + len, p, close - p);
+                    len += close - p;
+                    field = OBJECT_VAL(tea_string_copy(T, ps->chars, len));
+                }
+                else
+                {
+                    field = OBJECT_VAL(tea_string_copy(T, start, close - start));
+                }
+                p = close + 1;
+                break;
+            }
+
+            if(p < end && *p != options->delimiter && *p != '\n' && *p != '\r')
+            {
+                ps->error = "Unexpected character after a quoted field";
+                ps->error_offset = p - ps->start;
+                return CSV_ERROR;
+            }
+        }
+        else
+        {
+            const char* start = p;
+            char delimiter = options->delimiter;
+            while(p < end && *p != delimiter && *p != '\n' && *p != '\r')
+            {
+                p++;
+            }
+
+            /* The field may go on in the next read */
+            if(p >= end && ps->more)
+                return CSV_MORE;
+
+            double n;
+            if(!csv_number_column(options, column))
+                field = OBJECT_VAL(tea_string_copy(T, start, p - start));
+            else if(p == start)
+                field = NULL_VAL;
+            else if(tea_strscan_number(start, p - start, &n))
+                field = NUMBER_VAL(n);
+            else
+                field = OBJECT_VAL(tea_string_copy(T, start, p - start));
+        }
+
+        tea_vm_push(T, field);
+        tea_write_value_array(T, &row->items, field);
+        tea_vm_pop(T, 1);
+
+        if(p < end && *p == options->delimiter)
+        {
+            p++;
+            if(p >= end)
+            {
+                if(ps->more)
+                    return CSV_MORE;
+
+                /* A trailing delimiter ends with an empty field */
+                tea_vm_push(T, csv_number_column(options, column + 1) ? NULL_VAL : OBJECT_VAL(tea_string_literal(T, "")));
+                tea_write_value_array(T, &row->items, T->top[-1]);
+                tea_vm_pop(T, 1);
+                break;
+            }
+            continue;
+        }
+        break;
+    }
+
+row_end:
+    if(p < end && *p == '\r')
+    {
+        p++;
+        if(p >= end && ps->more)
+            return CSV_MORE;
+    }
+    if(p < end && *p == '\n')
+    {
+        p++;
+    }
+    ps->p = p;
+    return CSV_ROW;
+}
+
+static void csv_init_parser(CsvParser* ps, TeaState* T, CsvOptions* options, const char* chars, size_t len, bool more)
+{
+    ps->T = T;
+    ps->start = ps->p = chars;
+    ps->end = chars + len;
+    ps->more = more;
+    ps->options = options;
+    ps->chars = NULL;
+    ps->chars_size = 0;
+    ps->error = NULL;
+    ps->error_offset = 0;
+}
+
+/*
+** Parses one row, putting the stack back unless it pushed a whole row.
+** Errors are raised only once the scratch space is freed
+*/
+static CsvStatus csv_parse(CsvParser* ps)
+{
+    TeaState* T = ps->T;
+    ptrdiff_t top = savestack(T, T->top);
+
+    CsvStatus status = csv_parse_row(ps);
+    TEA_FREE_ARRAY(T, char, ps->chars, ps->chars_size);
+    ps->chars = NULL;
+    ps->chars_size = 0;
+
+    if(status != CSV_ROW)
+    {
+        T->top = restorestack(T, top);
+    }
+    if(status == CSV_ERROR)
+    {
+        tea_error(T, "%s at offset %d", ps->error, ps->error_offset);
+    }
+    return status;
+}
+
+/* How far a row read from a file has been looked over, kept across fills */
+typedef struct
+{
+    bool quoted;        /* Inside a quoted field */
+    bool closed;        /* Just past a quote that may be the first of a doubled pair */
+    bool field_start;
+    bool done;
+    size_t scanned;
+} CsvBounds;
+
+/*
+** Looks over the bytes added since the last call, returns true once the row
+** may be whole. The parse waits for that, so a long quoted field spread over
+** many fills is not parsed again after each one
+*/
+static bool csv_bounds(CsvBounds* b, CsvOptions* options, const char* start, const char* end)
+{
+    const char* p = start + b->scanned;
+    bool done = b->done;
+    while(p < end && !done)
+    {
+        if(b->quoted)
+        {
+            const char* close = memchr(p, options->quote, end - p);
+            if(close == NULL)
+            {
+                p = end;
+                break;
+            }
+            p = close + 1;
+            b->quoted = false;
+            b->closed = true;
+            continue;
+        }
+
+        char c = *p++;
+        if(b->closed && c == options->quote)
+        {
+            b->quoted = true;
+        }
+        else if(c == '\n' || c == '\r')
+        {
+            done = true;
+        }
+        else if(c == options->delimiter)
+        {
+            b->field_start = true;
+        }
+        else if(c == options->quote && b->field_start)
+        {
+            b->quoted = true;
+        }
+        else
+        {
+            b->field_start = false;
+        }
+        b->closed = false;
+    }
+    b->scanned = p - start;
+    b->done = done;
+    return done;
+}
+
+/* Pushes the next row of a file, or null at its end */
+static void csv_read_file(TeaState* T, TeaObjectFile* file, CsvOptions* options)
+{
+    CsvParser ps;
+    if(file->map != NULL)
+    {
+        csv_init_parser(&ps, T, options, file->map + file->map_pos, file->map_size - file->map_pos, false);
+        if(csv_parse(&ps) == CSV_END)
+        {
+            tea_push_null(T);
+            return;
+        }
+        file->map_pos += ps.p - ps.start;
+        return;
+    }
+
+    CsvBounds bounds = { false, false, true, false, 0 };
+    bool more = true;
+    while(true)
+    {
+        if(file->buffer != NULL)
+        {
+            const char* start = file->buffer + file->buffer_start;
+            const char* end = file->buffer + file->buffer_end;
+            if(more && !csv_bounds(&bounds, options, start, end))
+            {
+                more = tea_file_fill(T, file) > 0;
+                continue;
+            }
+
+            csv_init_parser(&ps, T, options, start, end - start, more);
+            CsvStatus status = csv_parse(&ps);
+            if(status == CSV_ROW)
+            {
+                file->buffer_start += ps.p - ps.start;
+                return;
+            }
+            if(status == CSV_END)
+            {
+                tea_push_null(T);
+                return;
+            }
+        }
+
+        /* The row is not all buffered yet */
+        more = tea_file_fill(T, file) > 0;
+    }
+}
+
+/*
+** A reader keeps its state under field names that cannot be written as
+** fields in a script, the offset and characters in userdata
+*/
+#define CSV_SOURCE "csv source"
+#define CSV_NUMBERS "csv numbers"
+#define CSV_STATE "csv state"
+
+typedef struct
+{
+    int offset;     /* Position in a string source */
+    char delimiter;
+    char quote;
+} CsvReader;
+
+static TeaValue csv_field(TeaState* T, TeaObjectInstance* reader, const char* name)
+{
+    TeaValue value = NULL_VAL;
+    tea_table_get(&reader->fields, tea_string_new(T, name), &value);
+    return value;
+}
+
+/* Pushes the next row of a reader, or null once it has run out */
+static void csv_next(TeaState* T)
+{
+    if(!IS_INSTANCE(T->base[0]))
+    {
+        tea_error(T, "Invalid csv reader");
+    }
+
+    TeaObjectInstance* instance = AS_INSTANCE(T->base[0]);
+    TeaValue source = csv_field(T, instance, CSV_SOURCE);
+    TeaValue state = csv_field(T, instance, CSV_STATE);
+
+    CsvOptions options;
+    options.numbers = csv_field(T, instance, CSV_NUMBERS);
+    if(!IS_USERDATA(state) || AS_USERDATA(state)->size != sizeof(CsvReader) ||
+       (!IS_BOOL(options.numbers) && !IS_LIST(options.numbers)))
+    {
+        tea_error(T, "Invalid csv reader");
+    }
+
+    CsvReader* reader = (CsvReader*)AS_USERDATA(state)->data;
+    options.delimiter = reader->delimiter;
+    options.quote = reader->quote;
+
+    if(IS_FILE(source))
+    {
+        TeaObjectFile* file = AS_FILE(source);
+        if(!file->is_open)
+        {
+            tea_error(T, "File is closed");
+        }
+        csv_read_file(T, file, &options);
+        return;
+    }
+
+    if(!IS_STRING(source))
+    {
+        tea_error(T, "Invalid csv reader");
+    }
+
+    TeaObjectString* string = AS_STRING(source);
+    int pos = reader->offset;
+    if(pos < 0 || pos > string->length)
+    {
+        tea_error(T, "Invalid csv reader");
+    }
+
+    CsvParser ps;
+    csv_init_parser(&ps, T, &options, string->chars + pos, string->length - pos, false);
+    if(csv_parse(&ps) == CSV_END)
+    {
+        tea_push_null(T);
+        return;
+    }
+    reader->offset = pos + (ps.p - ps.start);
+}
+
+/*
+** reader(source, options = null) reads rows from a string or a file that is
+** open for reading. Options may set the delimiter and quote characters and
+** which columns to read as numbers
+*/
+static void reader_constructor(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 3, "Expected 1 or 2 arguments, got %d", count - 1);
+
+    if(tea_is_file(T, 1))
+    {
+        TeaObjectFile* file = AS_FILE(T->base[1]);
+        if(strcmp(file->type->chars, "w") == 0)
+        {
+            tea_error(T, "File is not readable");
+        }
+    }
+    else if(!tea_is_string(T, 1))
+    {
+        tea_error(T, "Expected a string or file, got %s", tea_type_name(T, 1));
+    }
+
+    CsvOptions options;
+    csv_options(T, 2, &options);
+
+    TeaObjectInstance* instance = AS_INSTANCE(T->base[0]);
+    tea_table_set(T, &instance->fields, tea_string_literal(T, CSV_SOURCE), T->base[1]);
+
+    /* The columns are copied so later changes to the list do not reach the reader */
+    if(IS_LIST(options.numbers))
+    {
+        TeaValueArray* columns = &AS_LIST(options.numbers)->items;
+        tea_new_list(T);
+        TeaObjectList* copy = AS_LIST(T->top[-1]);
+        for(int i = 0; i < columns->count; i++)
+        {
+            tea_write_value_array(T, &copy->items, columns->values[i]);
+        }
+        tea_table_set(T, &instance->fields, tea_string_literal(T, CSV_NUMBERS), OBJECT_VAL(copy));
+    }
+    else
+    {
+        tea_table_set(T, &instance->fields, tea_string_literal(T, CSV_NUMBERS), BOOL_VAL(IS_BOOL(options.numbers) && AS_BOOL(options.numbers)));
+    }
+
+    CsvReader* reader = tea_new_userdata(T, sizeof(CsvReader));
+    reader->offset = 0;
+    reader->delimiter = options.delimiter;
+    reader->quote = options.quote;
+    tea_table_set(T, &instance->fields, tea_string_literal(T, CSV_STATE), T->top[-1]);
+
+    tea_set_top(T, 1);
+}
+
+static void reader_read(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 0 arguments, got %d", count - 1);
+
+    csv_next(T);
+}
+
+/* The row is the loop state, as with the lines of a file */
+static void reader_iterate(TeaState* T)
+{
+    csv_next(T);
+}
+
+static void reader_iteratorvalue(TeaState* T)
+{
+    tea_set_top(T, 2);
+}
+
+static const TeaClass reader_class[] = {
+    { "constructor", "method", reader_constructor },
+    { "read", "method", reader_read },
+    { "iterate", "method", reader_iterate },
+    { "iteratorvalue", "method", reader_iteratorvalue },
+    { NULL, NULL, NULL }
+};
+
+/* parse(text, options = null) reads every row of a string at once */
+static void csv_parse_all(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    int len;
+    const char* chars = tea_check_lstring(T, 0, &len);
+    CsvOptions options;
+    csv_options(T, 1, &options);
+
+    tea_new_list(T);
+    TeaObjectList* rows = AS_LIST(T->top[-1]);
+
+    CsvParser ps;
+    csv_init_parser(&ps, T, &options, chars, len, false);
+    while(csv_parse(&ps) == CSV_ROW)
+    {
+        tea_write_value_array(T, &rows->items, T->top[-1]);
+        tea_vm_pop(T, 1);
+    }
+}
+
+typedef struct
+{
+    TeaState* T;
+    TeaObjectFile* file;    /* Written to as it fills, or NULL to keep it all */
+    TeaObjectBuffer* out;   /* On the stack, so an error frees it like any other object */
+    char* chars;
+    int len;
+} CsvWriter;
+
+/* Pushes the buffer the writer formats into */
+static void csv_init_writer(CsvWriter* w, TeaState* T, TeaObjectFile* file)
+{
+    w->T = T;
+    w->file = file;
+    w->out = tea_obj_new_buffer(T, 256);
+    tea_vm_push(T, OBJECT_VAL(w->out));
+    w->chars = (char*)w->out->bytes;
+    w->len = 0;
+}
+
+static void csv_grow(CsvWriter* w, int more)
+{
+    if(w->len + more > w->out->capacity)
+    {
+        tea_obj_buffer_resize(w->T, w->out, w->len + more);
+        w->chars = (char*)w->out->bytes;
+    }
+}
+
+static void csv_put(CsvWriter* w, const char* chars, int len)
+{
+    csv_grow(w, len);
+    memcpy(w->chars + w->len, chars, len);
+    w->len += len;
+}
+
+static void csv_flush(CsvWriter* w)
+{
+    if(w->file == NULL || w->len == 0)
+        return;
+
+    if(w->file->file == stdout)
+        tea_state_write(w->T, w->chars, w->len);
+    else
+        tea_file_write(w->T, w->file, w->chars, w->len, false);
+    w->len = 0;
+}
+
+static void csv_put_string(CsvWriter* w, CsvOptions* options, const char* chars, int len)
+{
+    bool quoted = false;
+    for(int i = 0; i < len; i++)
+    {
+        char c = chars[i];
+        if(c == options->delimiter || c == options->quote || c == '\n' || c == '\r')
+        {
+            quoted = true;
+            break;
+        }
+    }
+
+    if(!quoted)
+    {
+        csv_put(w, chars, len);
+        return;
+    }
+
+    /* Quotes inside are doubled */
+    csv_grow(w, len * 2 + 2);
+    w->chars[w->len++] = options->quote;
+    for(int i = 0; i < len; i++)
+    {
+        if(chars[i] == options->quote)
+            w->chars[w->len++] = options->quote;
+        w->chars[w->len++] = chars[i];
+    }
+    w->chars[w->len++] = options->quote;
+}
+
+/* Returns the name of a type that cannot be written, or NULL */
+static const char* csv_put_rows(CsvWriter* w, CsvOptions* options, TeaObjectList* rows)
+{
+    for(int i = 0; i < rows->items.count; i++)
+    {
+        TeaValue row = rows->items.values[i];
+        if(!IS_LIST(row))
+            return "rows that are not lists";
+
+        TeaValueArray* fields = &AS_LIST(row)->items;
+        for(int j = 0; j < fields->count; j++)
+        {
+            if(j > 0)
+                csv_put(w, &options->delimiter, 1);
+
+            TeaValue field = fields->values[j];
+            if(IS_STRING(field))
+            {
+                csv_put_string(w, options, AS_CSTRING(field), AS_STRING(field)->length);
+            }
+            else if(IS_NUMBER(field))
+            {
+                csv_grow(w, STRFMT_MAXBUF_NUM);
+                w->len += tea_strfmt_number(w->chars + w->len, AS_NUMBER(field));
+            }
+            else if(IS_BOOL(field))
+            {
+                AS_BOOL(field) ? csv_put(w, "true", 4) : csv_put(w, "false", 5);
+            }
+            else if(!IS_NULL(field))
+            {
+                return tea_value_type(field);
+            }
+        }
+        csv_put(w, "\n", 1);
+
+        if(w->len >= CSV_FLUSH_SIZE)
+            csv_flush(w);
+    }
+    return NULL;
+}
+
+static void csv_write_rows(TeaState* T, CsvWriter* w, TeaObjectFile* file, int rows_index, int options_index)
+{
+    tea_check_list(T, rows_index);
+    CsvOptions options;
+    csv_options(T, options_index, &options);
+    csv_init_writer(w, T, file);
+
+    const char* error = csv_put_rows(w, &options, AS_LIST(T->base[rows_index]));
+    if(error != NULL)
+    {
+        tea_error(T, "Cannot write %s as CSV", error);
+    }
+}
+
+/* format(rows, options = null) lays out a list of rows as CSV text */
+static void csv_format(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    CsvWriter w;
+    csv_write_rows(T, &w, NULL, 0, 1);
+
+    tea_push_lstring(T, w.chars, w.len);
+}
+
+/* write(file, rows, options = null) writes a list of rows to a file as it formats them */
+static void csv_write(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 3, "Expected 2 or 3 arguments, got %d", count);
+
+    tea_check_file(T, 0);
+    TeaObjectFile* file = AS_FILE(T->base[0]);
+    if(!file->is_open || strcmp(file->type->chars, "r") == 0 || file->map != NULL)
+    {
+        tea_error(T, "File is not writable");
+    }
+
+    CsvWriter w;
+    csv_write_rows(T, &w, file, 1, 2);
+    csv_flush(&w);
+
+    tea_push_null(T);
+}
+
+static const TeaModule csv_module[] = {
+    { "reader", NULL },
+    { "parse", csv_parse_all },
+    { "format", csv_format },
+    { "write", csv_write },
+    { NULL, NULL }
+};
+
+TEAMOD_API void tea_import_csv(TeaState* T)
+{
+    tea_create_module(T, TEA_CSV_MODULE, csv_module);
+    tea_create_class(T, "reader", reader_class);
+    tea_set_key(T, 0, "reader");
+}
@@ -48,12 +48,21 @@ static void print_object(TeaValue object)
         case OBJ_MAP: 
             printf("<map>");
             break;
+        case OBJ_SET: 
+            printf("<set>");
+            break;
         case OBJ_MODULE: 
             printf("<module>"); 
             break;
         case OBJ_RANGE:
             printf("<range>"); 
             break;
+        case OBJ_ITERATOR:
+            printf("<iterator>"); 
+            break;
+        case OBJ_BUFFER:
+            printf("<buffer>"); 
+            break;
         case OBJ_STRING:
         {
             TeaObjectString* string = AS_STRING(object);
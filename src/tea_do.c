@@ -48,7 +48,7 @@ static void correct_stack(TeaState* T, TeaValue* old_stack)
 {
     T->top = (T->top - old_stack) + T->stack;
 
-    for(TeaCallInfo* ci = T->base_ci; ci <= T->ci; ci++)
+    for(TeaCallInfo* ci = T->base_ci; ci < T->ci; ci++)
     {
         ci->base = (ci->base - old_stack) + T->stack;
     }
@@ -238,6 +238,65 @@ void tea_do_call(TeaState* T, TeaValue func, int arg_count)
     T->nccalls--;
 }
 
+void tea_do_prepare_call(TeaState* T, TeaPreparedCall* call, TeaValue func, int arg_count)
+{
+    call->func = func;
+    call->arg_count = arg_count;
+    call->closure = NULL;
+
+    if(IS_CLOSURE(func))
+    {
+        TeaObjectFunction* function = AS_CLOSURE(func)->function;
+        if(function->arity == arg_count && function->arity_optional == 0 && !function->variadic)
+        {
+            call->closure = AS_CLOSURE(func);
+        }
+    }
+
+    /* The whole batch of calls counts as one level of C recursion */
+    if(++T->nccalls >= TEA_MAX_CCALLS)
+    {
+        puts("C stack overflow");
+        tea_do_throw(T, TEA_RUNTIME_ERROR);
+    }
+}
+
+/*
+** Calls the prepared function with the function and its arguments on top
+** of the stack, as tea_do_call does, leaving the result in their place
+*/
+void tea_do_prepared_call(TeaState* T, TeaPreparedCall* call)
+{
+    TeaObjectClosure* closure = call->closure;
+    if(closure == NULL)
+    {
+        tea_do_precall(T, call->func, call->arg_count);
+        if(IS_CLOSURE(call->func))
+        {
+            tea_vm_run(T);
+        }
+        return;
+    }
+
+    /* Arity was checked up front, so push the frame and run */
+    tea_do_grow_ci(T);
+    teaD_checkstack(T, closure->function->max_slots);
+
+    TeaCallInfo* ci = T->ci++;
+    ci->closure = closure;
+    ci->native = NULL;
+    ci->ip = closure->function->chunk.code;
+    ci->base = T->top - call->arg_count - 1;
+
+    tea_vm_run(T);
+}
+
+void tea_do_finish_call(TeaState* T, TeaPreparedCall* call)
+{
+    (void)call;
+    T->nccalls--;
+}
+
 static void restore_stack_limit(TeaState* T)
 {
     T->stack_last = T->stack + T->stack_size - 1;
@@ -277,6 +336,7 @@ void tea_do_throw(TeaState* T, int code)
     }
     else
     {
+        tea_state_drain(T);
         T->panic(T);
         exit(EXIT_FAILURE);
     }
@@ -30,6 +30,18 @@ void tea_do_precall(TeaState* T, TeaValue callee, uint8_t arg_count);
 void tea_do_call(TeaState* T, TeaValue func, int arg_count);
 int tea_do_pcall(TeaState* T, TeaValue func, int arg_count);
 
+/* A function checked once for calling from C many times with the same argument count */
+typedef struct
+{
+    TeaValue func;
+    TeaObjectClosure* closure;  /* Set when the arguments never need adjusting */
+    int arg_count;
+} TeaPreparedCall;
+
+void tea_do_prepare_call(TeaState* T, TeaPreparedCall* call, TeaValue func, int arg_count);
+void tea_do_prepared_call(TeaState* T, TeaPreparedCall* call);
+void tea_do_finish_call(TeaState* T, TeaPreparedCall* call);
+
 void tea_do_throw(TeaState* T, int code);
 
 int tea_do_runprotected(TeaState* T, TeaPFunction f, void* ud);
@@ -0,0 +1,553 @@
+/*
+** tea_eventlib.c
+** Teascript event module
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#define tea_eventlib_c
+#define TEA_LIB
+
+#include "tea.h"
+#include "tealib.h"
+
+#include "tea_import.h"
+#include "tea_core.h"
+#include "tea_state.h"
+#include "tea_memory.h"
+#include "tea_map.h"
+#include "tea_gc.h"
+#include "tea_vm.h"
+
+#if defined(TEA_USE_EPOLL)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#endif
+
+/* Most readiness events handled per wait */
+#define EVENT_BATCH 64
+
+/* Largest read done by event.read in one call */
+#define EVENT_READ_MAX 65536
+
+typedef struct
+{
+    double when;
+    double interval;
+    int id;
+} Timer;
+
+/*
+** Timers wait in a binary heap ordered by deadline. Cancelled timers stay
+** in the heap until they come up, their callback is gone from the map
+*/
+struct TeaEventLoop
+{
+    int epfd;
+    int next_id;
+    bool stop;
+    Timer* heap;
+    int heap_count;
+    int heap_capacity;
+    TeaObjectMap* timers;
+    TeaObjectMap* watchers;
+};
+
+void tea_event_mark(TeaState* T)
+{
+    if(T->loop == NULL)
+        return;
+
+    tea_gc_mark_object(T, (TeaObject*)T->loop->timers);
+    tea_gc_mark_object(T, (TeaObject*)T->loop->watchers);
+}
+
+void tea_event_close(TeaState* T)
+{
+    TeaEventLoop* loop = T->loop;
+    if(loop == NULL)
+        return;
+
+#if defined(TEA_USE_EPOLL)
+    if(loop->epfd >= 0)
+    {
+        close(loop->epfd);
+    }
+#endif
+    TEA_FREE_ARRAY(T, Timer, loop->heap, loop->heap_capacity);
+    TEA_FREE(T, TeaEventLoop, loop);
+    T->loop = NULL;
+}
+
+/* Stops watching a descriptor, for modules that close their own */
+void tea_event_forget(TeaState* T, int fd)
+{
+    TeaEventLoop* loop = T->loop;
+    if(loop == NULL || !tea_map_delete(T, loop->watchers, NUMBER_VAL(fd)))
+        return;
+
+#if defined(TEA_USE_EPOLL)
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+}
+
+#if defined(TEA_USE_EPOLL)
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void heap_push(TeaState* T, TeaEventLoop* loop, Timer timer)
+{
+    if(loop->heap_count == loop->heap_capacity)
+    {
+        int old_capacity = loop->heap_capacity;
+        loop->heap_capacity = TEA_GROW_CAPACITY(old_capacity);
+        loop->heap = TEA_GROW_ARRAY(T, Timer, loop->heap, old_capacity, loop->heap_capacity);
+    }
+
+    int i = loop->heap_count++;
+    while(i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if(loop->heap[parent].when <= timer.when)
+            break;
+        loop->heap[i] = loop->heap[parent];
+        i = parent;
+    }
+    loop->heap[i] = timer;
+}
+
+static Timer heap_pop(TeaEventLoop* loop)
+{
+    Timer top = loop->heap[0];
+    Timer last = loop->heap[--loop->heap_count];
+    int count = loop->heap_count;
+
+    int i = 0;
+    while(true)
+    {
+        int child = 2 * i + 1;
+        if(child >= count)
+            break;
+        if(child + 1 < count && loop->heap[child + 1].when < loop->heap[child].when)
+            child++;
+        if(last.when <= loop->heap[child].when)
+            break;
+        loop->heap[i] = loop->heap[child];
+        i = child;
+    }
+    if(count > 0)
+    {
+        loop->heap[i] = last;
+    }
+    return top;
+}
+
+static TeaEventLoop* get_loop(TeaState* T)
+{
+    TeaEventLoop* loop = T->loop;
+    if(loop->epfd < 0)
+    {
+        loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if(loop->epfd < 0)
+        {
+            tea_error(T, "Unable to create event loop: %s", strerror(errno));
+        }
+    }
+    return loop;
+}
+
+/* File descriptors can be given as numbers or open files */
+static int check_fd(TeaState* T, int index)
+{
+    if(tea_is_file(T, index))
+    {
+        TeaObjectFile* file = AS_FILE(T->base[index]);
+        if(!file->is_open)
+        {
+            tea_error(T, "File is closed");
+        }
+        return fileno(file->file);
+    }
+
+    double fd = tea_check_number(T, index);
+    if(fd < 0 || fd != (int)fd)
+    {
+        tea_error(T, "Expected a file descriptor");
+    }
+    return (int)fd;
+}
+
+static void add_timer(TeaState* T, bool repeat)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 2 arguments, got %d", count);
+
+    double delay = tea_check_number(T, 0);
+    tea_check_any(T, 1);
+    if(delay < 0 || (repeat && delay == 0))
+    {
+        tea_error(T, repeat ? "Expected an interval above 0 seconds" : "Expected a delay of 0 or more seconds");
+    }
+
+    TeaEventLoop* loop = get_loop(T);
+    Timer timer;
+    timer.when = now() + delay;
+    timer.interval = repeat ? delay : -1;
+    timer.id = ++loop->next_id;
+
+    tea_map_set(T, loop->timers, NUMBER_VAL(timer.id), T->base[1]);
+    heap_push(T, loop, timer);
+    tea_push_number(T, timer.id);
+}
+
+static void event_timeout(TeaState* T)
+{
+    add_timer(T, false);
+}
+
+static void event_interval(TeaState* T)
+{
+    add_timer(T, true);
+}
+
+static void event_cancel(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    double id = tea_check_number(T, 0);
+    tea_push_bool(T, tea_map_delete(T, get_loop(T)->timers, NUMBER_VAL(id)));
+}
+
+static void event_watch(TeaState* T)
+{
+    static const char* const modes[] = { "r", "w", "rw", NULL };
+
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 3, "Expected 3 arguments, got %d", count);
+
+    int fd = check_fd(T, 0);
+    int mode = tea_check_option(T, 1, NULL, modes);
+    tea_check_any(T, 2);
+
+    TeaEventLoop* loop = get_loop(T);
+    struct epoll_event ev;
+    ev.events = (mode != 1 ? EPOLLIN : 0) | (mode != 0 ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+
+    TeaValue _;
+    int op = tea_map_get(loop->watchers, NUMBER_VAL(fd), &_) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if(epoll_ctl(loop->epfd, op, fd, &ev) != 0)
+    {
+        tea_error(T, "Unable to watch %d: %s", fd, strerror(errno));
+    }
+
+    tea_map_set(T, loop->watchers, NUMBER_VAL(fd), T->base[2]);
+    tea_push_null(T);
+}
+
+static void event_unwatch(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    tea_event_forget(T, check_fd(T, 0));
+    tea_push_null(T);
+}
+
+/* Runs the due timers, returning the milliseconds until the next one or -1 */
+static int run_timers(TeaState* T, TeaEventLoop* loop)
+{
+    while(loop->heap_count > 0 && !loop->stop)
+    {
+        Timer* next = &loop->heap[0];
+        TeaValue callback;
+        if(!tea_map_get(loop->timers, NUMBER_VAL(next->id), &callback))
+        {
+            heap_pop(loop);
+            continue;
+        }
+
+        double left = next->when - now();
+        if(left > 0)
+            return (int)ceil(left * 1000);
+
+        /* Keep the callback reachable once the map lets go of it */
+        tea_vm_push(T, callback);
+
+        Timer timer = heap_pop(loop);
+        if(timer.interval > 0)
+        {
+            timer.when += timer.interval;
+            heap_push(T, loop, timer);
+        }
+        else
+        {
+            tea_map_delete(T, loop->timers, NUMBER_VAL(timer.id));
+        }
+
+        tea_call(T, 0);
+        tea_pop(T, 1);
+    }
+    return -1;
+}
+
+static void run_watchers(TeaState* T, TeaEventLoop* loop, int timeout)
+{
+    struct epoll_event events[EVENT_BATCH];
+
+    tea_state_flush(T);
+    int n = epoll_wait(loop->epfd, events, EVENT_BATCH, timeout);
+    if(n < 0)
+    {
+        if(errno == EINTR)
+            return;
+        tea_error(T, "Unable to wait for events: %s", strerror(errno));
+    }
+
+    for(int i = 0; i < n && !loop->stop; i++)
+    {
+        int fd = events[i].data.fd;
+        uint32_t flags = events[i].events;
+
+        /* An earlier callback may have stopped watching it */
+        TeaValue callback;
+        if(!tea_map_get(loop->watchers, NUMBER_VAL(fd), &callback))
+            continue;
+
+        /* Hangups and errors are reported as readable, reading finds out which */
+        bool readable = flags & (EPOLLIN | EPOLLHUP | EPOLLERR);
+        bool writable = flags & EPOLLOUT;
+
+        tea_vm_push(T, callback);
+        tea_push_number(T, fd);
+        tea_push_string(T, readable && writable ? "rw" : readable ? "r" : "w");
+        tea_call(T, 2);
+        tea_pop(T, 1);
+    }
+}
+
+/* Runs until stopped or there are no timers or watched descriptors left */
+static void event_run(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 0, "Expected 0 arguments, got %d", count);
+
+    TeaEventLoop* loop = get_loop(T);
+    loop->stop = false;
+
+    while(!loop->stop)
+    {
+        int timeout = run_timers(T, loop);
+        if(loop->stop)
+            break;
+
+        if(loop->watchers->count == 0)
+        {
+            if(timeout < 0)
+                break;
+            tea_state_flush(T);
+            struct timespec ts;
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000L;
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        run_watchers(T, loop, timeout);
+    }
+
+    loop->stop = false;
+    tea_push_null(T);
+}
+
+static void event_stop(TeaState* T)
+{
+    get_loop(T)->stop = true;
+    tea_push_null(T);
+}
+
+static void event_now(TeaState* T)
+{
+    tea_push_number(T, now());
+}
+
+static void set_nonblock(TeaState* T, int fd, bool on)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETFL, on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) < 0)
+    {
+        tea_error(T, "Unable to change %d: %s", fd, strerror(errno));
+    }
+}
+
+static void event_nonblock(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    set_nonblock(T, check_fd(T, 0), tea_opt_bool(T, 1, true));
+    tea_push_null(T);
+}
+
+/* A pipe with both ends non blocking, as [read, write] */
+static void event_pipe(TeaState* T)
+{
+    int fds[2];
+    if(pipe(fds) != 0)
+    {
+        tea_error(T, "Unable to create pipe: %s", strerror(errno));
+    }
+    for(int i = 0; i < 2; i++)
+    {
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        set_nonblock(T, fds[i], true);
+    }
+
+    tea_new_list(T);
+    tea_push_number(T, fds[0]);
+    tea_add_item(T, -2);
+    tea_push_number(T, fds[1]);
+    tea_add_item(T, -2);
+}
+
+/* Reads what is available, "" when it would block and null at the end */
+static void event_read(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    int fd = check_fd(T, 0);
+    double max = tea_opt_number(T, 1, EVENT_READ_MAX);
+    if(max < 1 || max > EVENT_READ_MAX)
+    {
+        tea_error(T, "Expected a size from 1 to %d", EVENT_READ_MAX);
+    }
+
+    char chars[EVENT_READ_MAX];
+    ssize_t n = read(fd, chars, (size_t)max);
+    if(n < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            tea_push_literal(T, "");
+            return;
+        }
+        tea_error(T, "Unable to read %d: %s", fd, strerror(errno));
+    }
+    if(n == 0)
+    {
+        tea_push_null(T);
+        return;
+    }
+    tea_push_lstring(T, chars, (int)n);
+}
+
+/* Writes what fits, returning the number of bytes taken */
+static void event_write(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 2 arguments, got %d", count);
+
+    int fd = check_fd(T, 0);
+    int len;
+    const char* data = tea_is_buffer(T, 1) ? tea_to_buffer(T, 1, &len) : tea_check_lstring(T, 1, &len);
+
+    if(fd == STDOUT_FILENO)
+    {
+        tea_state_flush(T);
+    }
+
+    ssize_t n = write(fd, data, len);
+    if(n < 0)
+    {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            tea_error(T, "Unable to write %d: %s", fd, strerror(errno));
+        }
+        n = 0;
+    }
+    tea_push_number(T, n);
+}
+
+static void event_close(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    double fd = tea_check_number(T, 0);
+    tea_event_forget(T, (int)fd);
+    tea_push_bool(T, close((int)fd) == 0);
+}
+
+#else
+
+static void event_unsupported(TeaState* T)
+{
+    tea_error(T, "Event loop is not supported on this platform");
+}
+
+#define event_timeout event_unsupported
+#define event_interval event_unsupported
+#define event_cancel event_unsupported
+#define event_watch event_unsupported
+#define event_unwatch event_unsupported
+#define event_run event_unsupported
+#define event_stop event_unsupported
+#define event_now event_unsupported
+#define event_nonblock event_unsupported
+#define event_pipe event_unsupported
+#define event_read event_unsupported
+#define event_write event_unsupported
+#define event_close event_unsupported
+
+#endif
+
+static const TeaModule event_module[] = {
+    { "timeout", event_timeout },
+    { "interval", event_interval },
+    { "cancel", event_cancel },
+    { "watch", event_watch },
+    { "unwatch", event_unwatch },
+    { "run", event_run },
+    { "stop", event_stop },
+    { "now", event_now },
+    { "nonblock", event_nonblock },
+    { "pipe", event_pipe },
+    { "read", event_read },
+    { "write", event_write },
+    { "close", event_close },
+    { NULL, NULL }
+};
+
+TEAMOD_API void tea_import_event(TeaState* T)
+{
+    if(T->loop == NULL)
+    {
+        TeaEventLoop* loop = TEA_ALLOCATE(T, TeaEventLoop, 1);
+        loop->epfd = -1;
+        loop->next_id = 0;
+        loop->stop = false;
+        loop->heap = NULL;
+        loop->heap_count = 0;
+        loop->heap_capacity = 0;
+        loop->timers = NULL;
+        loop->watchers = NULL;
+        T->loop = loop;
+
+        loop->timers = tea_map_new(T);
+        loop->watchers = tea_map_new(T);
+    }
+
+    tea_create_module(T, TEA_EVENT_MODULE, event_module);
+}
@@ -9,6 +9,8 @@
 #include <ctype.h>
 #include <errno.h>
 #include <math.h>
+#include <limits.h>
+#include <sys/stat.h>
 
 #define tea_fileclass_c
 #define TEA_CORE
@@ -20,6 +22,63 @@
 #include "tea_string.h"
 #include "tea_core.h"
 
+#if defined(TEA_USE_POSIX)
+#include <sys/mman.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+/* Empty files have nothing to map, they all share an empty view */
+static char empty_map[1];
+
+/*
+** Maps an open file read only. The mapping lives outside the heap, so it
+** is not counted towards the bytes that drive collection
+*/
+void tea_file_map(TeaState* T, TeaObjectFile* file)
+{
+#if defined(TEA_USE_POSIX)
+    struct stat st;
+    int fd = fileno(file->file);
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        tea_error(T, "Unable to map file '%s'", file->path->chars);
+    }
+
+    if(st.st_size == 0)
+    {
+        file->map = empty_map;
+        return;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        tea_error(T, "Unable to map file '%s'", file->path->chars);
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    file->map = map;
+    file->map_size = st.st_size;
+#else
+    tea_error(T, "Mapped files are not supported on this platform");
+#endif
+}
+
+void tea_file_unmap(TeaObjectFile* file)
+{
+#if defined(TEA_USE_POSIX)
+    if(file->map != NULL && file->map != empty_map)
+    {
+        munmap(file->map, file->map_size);
+    }
+#endif
+    file->map = NULL;
+    file->map_size = 0;
+    file->map_pos = 0;
+}
+
 static TeaObjectFile* get_file(TeaState* T)
 {
     tea_check_file(T, 0);
@@ -31,6 +90,26 @@ static TeaObjectFile* get_file(TeaState* T)
     return file;
 }
 
+static TeaObjectFile* get_map(TeaState* T)
+{
+    TeaObjectFile* file = get_file(T);
+    if(file->map == NULL)
+    {
+        tea_error(T, "File is not memory mapped");
+    }
+    return file;
+}
+
+/* Copies part of a mapping into a string */
+static void push_view(TeaState* T, const char* chars, size_t length)
+{
+    if(length >= INT_MAX)
+    {
+        tea_error(T, "Mapped range is too large for a string");
+    }
+    tea_vm_push(T, OBJECT_VAL(tea_string_copy(T, chars, (int)length)));
+}
+
 static void file_closed(TeaState* T)
 {
     tea_push_bool(T, !get_file(T)->is_open);
@@ -46,6 +125,97 @@ static void file_type(TeaState* T)
     tea_vm_push(T, OBJECT_VAL(get_file(T)->type));
 }
 
+/* Unread bytes held in the line buffer */
+#define BUFFERED(file) ((file)->buffer_end - (file)->buffer_start)
+
+/* Moves the stream back over any read ahead so writes land where reading stopped */
+static void file_sync(TeaObjectFile* file)
+{
+    if(BUFFERED(file) > 0)
+    {
+        fseek(file->file, -BUFFERED(file), SEEK_CUR);
+    }
+    file->buffer_start = file->buffer_end = 0;
+}
+
+/* Bytes to write, strings and buffers are written as they are */
+static const char* check_data(TeaState* T, int index, int* len)
+{
+    if(tea_is_buffer(T, index))
+    {
+        return tea_to_buffer(T, index, len);
+    }
+    return tea_check_lstring(T, index, len);
+}
+
+/*
+** Holds SIGPIPE off so a write to a pipe or socket whose reader has gone
+** away fails with EPIPE instead of ending the interpreter. Returns whether
+** it was already held, which is handed back to tea_file_release_sigpipe
+*/
+bool tea_file_hold_sigpipe(void)
+{
+#if defined(TEA_USE_POSIX)
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    sigprocmask(SIG_BLOCK, &pipe_set, &old_set);
+    return sigismember(&old_set, SIGPIPE);
+#else
+    return true;
+#endif
+}
+
+/* Takes back a SIGPIPE raised while it was held, leaving errno alone */
+void tea_file_release_sigpipe(bool held)
+{
+#if defined(TEA_USE_POSIX)
+    if(held)
+        return;
+
+    int saved_errno = errno;
+    sigset_t pipe_set, pending;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    sigpending(&pending);
+    if(sigismember(&pending, SIGPIPE))
+    {
+        int sig;
+        sigwait(&pipe_set, &sig);
+    }
+    sigprocmask(SIG_UNBLOCK, &pipe_set, NULL);
+    errno = saved_errno;
+#else
+    (void)held;
+#endif
+}
+
+/*
+** Writes and flushes, with a newline after when asked. A pipe whose reader
+** has gone away is a runtime error rather than a SIGPIPE that ends the
+** interpreter
+*/
+size_t tea_file_write(TeaState* T, TeaObjectFile* file, const char* chars, size_t len, bool newline)
+{
+    bool held = tea_file_hold_sigpipe();
+
+    size_t wrote = fwrite(chars, sizeof(char), len, file->file);
+    if(newline)
+    {
+        wrote += fwrite("\n", sizeof(char), 1, file->file);
+    }
+    bool broken = (fflush(file->file) != 0 || ferror(file->file)) && errno == EPIPE;
+
+    tea_file_release_sigpipe(held);
+
+    if(broken)
+    {
+        clearerr(file->file);
+        tea_error(T, "Unable to write to '%s': %s", file->path->chars, strerror(EPIPE));
+    }
+    return wrote;
+}
+
 static void file_write(TeaState* T)
 {
     int count = tea_get_top(T);
@@ -54,17 +224,22 @@ static void file_write(TeaState* T)
     TeaObjectFile* file = get_file(T);
 
     int len;
-    const char* string = tea_check_lstring(T, 1, &len);
+    const char* string = check_data(T, 1, &len);
 
-    if(strcmp(file->type->chars, "r") == 0)
+    if(strcmp(file->type->chars, "r") == 0 || file->map != NULL)
     {
         tea_error(T, "File is not writable");
     }
 
-    int chars_wrote = fwrite(string, sizeof(char), len, file->file);
-    fflush(file->file);
+    if(file->file == stdout)
+    {
+        tea_state_write(T, string, len);
+        tea_push_number(T, len);
+        return;
+    }
 
-    tea_push_number(T, chars_wrote);
+    file_sync(file);
+    tea_push_number(T, tea_file_write(T, file, string, len, false));
 }
 
 static void file_writeline(TeaState* T)
@@ -75,26 +250,158 @@ static void file_writeline(TeaState* T)
     TeaObjectFile* file = get_file(T);
 
     int len;
-    const char* string = tea_check_lstring(T, 1, &len);
+    const char* string = check_data(T, 1, &len);
 
-    if(strcmp(file->type->chars, "r") == 0)
+    if(strcmp(file->type->chars, "r") == 0 || file->map != NULL)
     {
         tea_error(T, "File is not writable");
     }
 
-    int chars_wrote = fwrite(string, sizeof(char), len, file->file);
-    chars_wrote += fwrite("\n", sizeof(char), 1, file->file);
-    fflush(file->file);
+    if(file->file == stdout)
+    {
+        tea_state_write(T, string, len);
+        tea_state_write(T, "\n", 1);
+        tea_push_number(T, len + 1);
+        return;
+    }
 
-    tea_push_number(T, chars_wrote);
+    file_sync(file);
+    tea_push_number(T, tea_file_write(T, file, string, len, true));
 }
 
 #define BUFFER_SIZE 1024
 
+/* Bytes left in a regular file, 0 when the size is not known up front */
+static size_t file_remaining(FILE* fp)
+{
+    struct stat st;
+    if(fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode))
+        return 0;
+
+    long pos = ftell(fp);
+    if(pos < 0 || pos >= st.st_size)
+        return 0;
+    return st.st_size - pos;
+}
+
+static bool is_regular(FILE* fp)
+{
+    struct stat st;
+    return fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/*
+** Reads up to n bytes, fewer only at the end of the file. Pipes, terminals
+** and sockets are read from the descriptor so that stdio never holds bytes
+** ahead of the line buffer
+*/
+static size_t read_raw(TeaObjectFile* file, char* dest, size_t n)
+{
+#if defined(TEA_USE_POSIX)
+    if(!file->regular)
+    {
+        int fd = fileno(file->file);
+        size_t got = 0;
+        while(got < n)
+        {
+            ssize_t r = read(fd, dest + got, n - got);
+            if(r < 0 && errno == EINTR)
+                continue;
+            if(r <= 0)
+                break;
+            got += r;
+        }
+        return got;
+    }
+#endif
+    return fread(dest, sizeof(char), n, file->file);
+}
+
+/*
+** Reads up to max bytes into a string. Regular files are read in one
+** allocation sized from the file, anything else doubles the buffer as it fills
+*/
+static void read_bytes(TeaState* T, TeaObjectFile* file, size_t max, bool null_at_eof, bool whole)
+{
+    FILE* fp = file->file;
+    if(file->buffer == NULL)
+    {
+        file->regular = is_regular(fp);
+    }
+    size_t buffered = BUFFERED(file);
+    size_t size = buffered + file_remaining(fp);
+    if(whole && size > max)
+    {
+        tea_error(T, "File is too large to read");
+    }
+    if(size == 0)
+        size = BUFFER_SIZE;
+    if(size > max)
+        size = max;
+
+    size_t capacity = size + 1;
+    size_t length = buffered < max ? buffered : max;
+    char* buffer = TEA_ALLOCATE(T, char, capacity);
+
+    /* Whatever line reading fetched ahead comes first */
+    memcpy(buffer, file->buffer + file->buffer_start, length);
+    file->buffer_start += length;
+
+    while(length < max)
+    {
+        if(length + 1 == capacity)
+        {
+            /* Only grow once there is more to read */
+            char c;
+            if(read_raw(file, &c, 1) == 0)
+                break;
+
+            size_t new_capacity = capacity * 2;
+            if(new_capacity > max + 1)
+                new_capacity = max + 1;
+            if(new_capacity > INT_MAX)
+                new_capacity = INT_MAX;
+            buffer = TEA_GROW_ARRAY(T, char, buffer, capacity, new_capacity);
+            capacity = new_capacity;
+            buffer[length++] = c;
+            continue;
+        }
+
+        size_t want = capacity - 1 - length;
+        size_t got = read_raw(file, buffer + length, want);
+        length += got;
+        if(got < want)
+            break;
+    }
+
+    /* A stream's size is only known once the limit is reached */
+    char c;
+    if(whole && length == max && read_raw(file, &c, 1) > 0)
+    {
+        TEA_FREE_ARRAY(T, char, buffer, capacity);
+        tea_error(T, "File is too large to read");
+    }
+
+    if(length == 0 && null_at_eof)
+    {
+        TEA_FREE_ARRAY(T, char, buffer, capacity);
+        tea_push_null(T);
+        return;
+    }
+
+    if(capacity != length + 1)
+    {
+        buffer = TEA_GROW_ARRAY(T, char, buffer, capacity, length + 1);
+    }
+    buffer[length] = '\0';
+
+    tea_vm_push(T, OBJECT_VAL(tea_string_take(T, buffer, length)));
+}
+
 static void file_read(TeaState* T)
 {
     int count = tea_get_top(T);
-    tea_ensure_min_args(T, count, 1);
+    tea_check_args(T, count > 2, "Expected 0 or 1 argument, got %d", count - 1);
     
     TeaObjectFile* file = get_file(T);
 
@@ -103,28 +410,189 @@ static void file_read(TeaState* T)
         tea_error(T, "File is not readable");
     }
 
-    size_t current_size = BUFFER_SIZE;
-    char* contents = TEA_ALLOCATE(T, char, current_size);
-    size_t read_bytes = 0;
-    size_t total_read_bytes = 0;
-    do
+    size_t max = INT_MAX - 1;
+    if(count == 2)
+    {
+        double n = tea_check_number(T, 1);
+        if(n < 0 || n > INT_MAX - 1)
+        {
+            tea_error(T, "Expected a size from 0 to %d", INT_MAX - 1);
+        }
+        max = (size_t)n;
+    }
+
+    /* A bounded read returns null once the file is exhausted */
+    bool null_at_eof = count == 2 && max > 0;
+
+    if(file->file == stdin)
+    {
+        tea_state_flush(T);
+    }
+
+    if(file->map != NULL)
+    {
+        size_t left = file->map_size - file->map_pos;
+        if(count == 1 && left > max)
+        {
+            tea_error(T, "File is too large to read");
+        }
+
+        size_t length = left < max ? left : max;
+        if(length == 0 && null_at_eof)
+        {
+            tea_push_null(T);
+            return;
+        }
+        push_view(T, file->map + file->map_pos, length);
+        file->map_pos += length;
+        return;
+    }
+
+    read_bytes(T, file, max, null_at_eof, count == 1);
+}
+
+#define LINE_BUFFER_SIZE 65536
+
+/* Appends more of the file after the buffered bytes, returns the number added */
+static size_t refill(TeaObjectFile* file)
+{
+    char* end = file->buffer + file->buffer_end;
+    int space = file->buffer_size - file->buffer_end;
+
+    if(file->regular)
+        return fread(end, sizeof(char), space, file->file);
+
+#if defined(TEA_USE_POSIX)
+    /*
+    ** Pipes and terminals wait for the first bytes only, then take whatever
+    ** else is already there
+    */
+    int fd = fileno(file->file);
+    size_t got = 0;
+    while(got < (size_t)space)
+    {
+        ssize_t r = read(fd, end + got, space - got);
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r <= 0)
+            break;
+        got += r;
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if(poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN))
+            break;
+    }
+    return got;
+#else
+    /* Without a way to tell what is ready, pipes and terminals take a line at a time */
+    if(fgets(end, space + 1, file->file) == NULL)
+        return 0;
+    return strlen(end);
+#endif
+}
+
+/*
+** Reads more of the file in after what is still unread in the buffer. The
+** unread part moves to the front, the buffer only grows when it is all
+** unread. Returns the bytes added, 0 at the end of the file
+*/
+size_t tea_file_fill(TeaState* T, TeaObjectFile* file)
+{
+    if(file->buffer == NULL)
+    {
+        /* One spare byte lets fgets terminate a full buffer */
+        file->buffer = TEA_ALLOCATE(T, char, LINE_BUFFER_SIZE + 1);
+        file->buffer_size = LINE_BUFFER_SIZE;
+        file->regular = is_regular(file->file);
+    }
+
+    int partial = BUFFERED(file);
+    if(file->buffer_start > 0)
+    {
+        memmove(file->buffer, file->buffer + file->buffer_start, partial);
+    }
+    else if(partial == file->buffer_size)
+    {
+        int old_size = file->buffer_size;
+        file->buffer_size *= 2;
+        file->buffer = TEA_GROW_ARRAY(T, char, file->buffer, old_size + 1, file->buffer_size + 1);
+    }
+    file->buffer_start = 0;
+    file->buffer_end = partial;
+
+    if(file->file == stdin)
+    {
+        tea_state_flush(T);
+    }
+
+    size_t got = refill(file);
+    file->buffer_end += got;
+    return got;
+}
+
+/* Pushes the next line without its newline, returns false at the end of the file */
+bool tea_file_readline(TeaState* T, TeaObjectFile* file)
+{
+    if(file->map != NULL)
+    {
+        if(file->map_pos >= file->map_size)
+            return false;
+
+        char* start = file->map + file->map_pos;
+        size_t left = file->map_size - file->map_pos;
+        char* newline = memchr(start, '\n', left);
+        size_t length = newline != NULL ? (size_t)(newline - start) : left;
+
+        push_view(T, start, length);
+        file->map_pos += length + (newline != NULL);
+        return true;
+    }
+
+    int scan = file->buffer_start;
+    while(true)
     {
-        read_bytes = fread(contents + total_read_bytes, sizeof(char), BUFFER_SIZE, file->file);
-        total_read_bytes += read_bytes;
-        if(total_read_bytes + BUFFER_SIZE > current_size)
+        if(file->buffer != NULL)
         {
-            int old_size = current_size;
-            current_size += BUFFER_SIZE;
-            contents = TEA_GROW_ARRAY(T, char, contents, old_size, current_size);
+            char* start = file->buffer + file->buffer_start;
+            char* newline = memchr(file->buffer + scan, '\n', file->buffer_end - scan);
+            if(newline != NULL)
+            {
+                int length = newline - start;
+                file->buffer_start += length + 1;
+                tea_vm_push(T, OBJECT_VAL(tea_string_copy(T, start, length)));
+                return true;
+            }
         }
-    } 
-    while(read_bytes == BUFFER_SIZE);
 
-    contents[total_read_bytes] = '\0';
+        int partial = BUFFERED(file);
+        if(tea_file_fill(T, file) == 0)
+        {
+            file->buffer_start = file->buffer_end = 0;
+            if(partial == 0)
+                return false;
 
-    contents = TEA_GROW_ARRAY(T, char, contents, current_size, total_read_bytes + 1);
+            /* Last line without a newline */
+            tea_vm_push(T, OBJECT_VAL(tea_string_copy(T, file->buffer, partial)));
+            return true;
+        }
+        scan = partial;
+    }
+}
 
-    tea_vm_push(T, OBJECT_VAL(tea_string_take(T, contents, total_read_bytes)));
+/* Standard input is one object, so io.stdin and input() share what is read ahead */
+TeaObjectFile* tea_file_stdin(TeaState* T)
+{
+    if(T->stdin_file == NULL)
+    {
+        tea_vm_push(T, OBJECT_VAL(tea_string_literal(T, "")));
+        tea_vm_push(T, OBJECT_VAL(tea_string_literal(T, "r")));
+        TeaObjectFile* file = tea_obj_new_file(T, AS_STRING(T->top[-2]), AS_STRING(T->top[-1]));
+        file->file = stdin;
+        file->is_open = -1;
+        T->stdin_file = file;
+        tea_vm_pop(T, 2);
+    }
+    return T->stdin_file;
 }
 
 static void file_readline(TeaState* T)
@@ -139,36 +607,81 @@ static void file_readline(TeaState* T)
         tea_error(T, "File is not readable");
     }
 
-    int current_size = BUFFER_SIZE;
-    char* line = TEA_ALLOCATE(T, char, current_size);
+    if(file->file == stdin)
+    {
+        tea_state_flush(T);
+    }
+
+    if(!tea_file_readline(T, file))
+    {
+        tea_push_null(T);
+    }
+}
+
+/* Reads into a buffer without making a string, returns the number of bytes read */
+static void file_readinto(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 4, "Expected 1 to 3 arguments, got %d", count - 1);
+
+    TeaObjectFile* file = get_file(T);
+    tea_check_buffer(T, 1);
+
+    if(strcmp(file->type->chars, "w") == 0)
+    {
+        tea_error(T, "File is not readable");
+    }
+
+    int len;
+    char* bytes = tea_to_buffer(T, 1, &len);
+    double offset = tea_opt_number(T, 2, 0);
+    if(offset < 0 || offset > len)
+    {
+        tea_error(T, "Buffer offset out of bounds");
+    }
+    double n = tea_opt_number(T, 3, len - offset);
+    if(n < 0 || n > len - offset)
+    {
+        tea_error(T, "Expected a size that fits in the buffer");
+    }
+
+    char* dest = bytes + (int)offset;
+    size_t want = (size_t)n;
+    size_t got;
+
+    if(file->file == stdin)
+    {
+        tea_state_flush(T);
+    }
 
-    while(fgets(line, BUFFER_SIZE, file->file) != NULL) 
+    if(file->map != NULL)
+    {
+        size_t left = file->map_size - file->map_pos;
+        got = want < left ? want : left;
+        memcpy(dest, file->map + file->map_pos, got);
+        file->map_pos += got;
+    }
+    else
     {
-        int line_length = strlen(line);
-        
-        if(line_length == BUFFER_SIZE && line[line_length - 1] != '\n')
+        /* Whatever line reading fetched ahead comes first */
+        size_t buffered = BUFFERED(file);
+        got = want < buffered ? want : buffered;
+        if(got > 0)
         {
-            int old_size = current_size;
-            current_size += BUFFER_SIZE;
-            line = TEA_GROW_ARRAY(T, char, line, old_size, current_size);
+            memcpy(dest, file->buffer + file->buffer_start, got);
+            file->buffer_start += got;
         }
-        else
+        if(got < want)
         {
-            /* Remove newline char */
-            if(line[line_length - 1] == '\n') 
+            if(file->buffer == NULL)
             {
-                line_length--;
+                file->regular = is_regular(file->file);
             }
-            line[line_length] = '\0';
-            line = TEA_GROW_ARRAY(T, char, line, current_size, line_length + 1);
-
-            tea_vm_push(T, OBJECT_VAL(tea_string_take(T, line, line_length)));
-            return;
+            got += read_raw(file, dest + got, want - got);
         }
     }
 
-    TEA_FREE_ARRAY(T, char, line, current_size);
-    tea_push_null(T);
+    tea_push_number(T, got);
 }
 
 static void file_seek(TeaState* T)
@@ -199,6 +712,20 @@ static void file_seek(TeaState* T)
         }
     }
 
+    if(file->map != NULL)
+    {
+        double base = seek_type == SEEK_SET ? 0 : (seek_type == SEEK_CUR ? file->map_pos : file->map_size);
+        double pos = base + tea_check_number(T, 1);
+        if(pos < 0 || pos > file->map_size)
+        {
+            tea_error(T, "Unable to seek file");
+        }
+
+        file->map_pos = (size_t)pos;
+        tea_push_null(T);
+        return;
+    }
+
     int offset = tea_check_number(T, 1);
 
     if(offset != 0 && !strstr(file->type->chars, "b")) 
@@ -206,6 +733,13 @@ static void file_seek(TeaState* T)
         tea_error(T, "May not have non-zero offset if file is opened in text mode");
     }
 
+    /* The stream is ahead of the script by whatever is still buffered */
+    if(seek_type == SEEK_CUR)
+    {
+        offset -= BUFFERED(file);
+    }
+    file->buffer_start = file->buffer_end = 0;
+
     if(fseek(file->file, offset, seek_type))
     {
         tea_error(T, "Unable to seek file");
@@ -214,6 +748,67 @@ static void file_seek(TeaState* T)
     tea_push_null(T);
 }
 
+static void file_flush(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 0 arguments, got %d", count - 1);
+
+    TeaObjectFile* file = get_file(T);
+    if(file->file == stdout)
+    {
+        tea_state_flush(T);
+    }
+    else
+    {
+        fflush(file->file);
+    }
+    tea_push_null(T);
+}
+
+/* Chooses when writes are passed on, "full", "line" or "none" */
+static void file_setbuffer(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+
+    TeaObjectFile* file = get_file(T);
+    const char* mode = tea_check_string(T, 1);
+
+    TeaOutMode out_mode;
+    int buf_mode;
+    if(strcmp(mode, "full") == 0)
+    {
+        out_mode = OUT_FULL;
+        buf_mode = _IOFBF;
+    }
+    else if(strcmp(mode, "line") == 0)
+    {
+        out_mode = OUT_LINE;
+        buf_mode = _IOLBF;
+    }
+    else if(strcmp(mode, "none") == 0)
+    {
+        out_mode = OUT_NONE;
+        buf_mode = _IONBF;
+    }
+    else
+    {
+        tea_error(T, "Expected a buffering mode of \"full\", \"line\" or \"none\"");
+        return;
+    }
+
+    if(file->file == stdout)
+    {
+        tea_state_flush(T);
+        T->out_mode = out_mode;
+    }
+    else if(setvbuf(file->file, NULL, buf_mode, BUFSIZ) != 0)
+    {
+        tea_error(T, "Unable to set the buffering mode");
+    }
+    tea_push_null(T);
+}
+
 static void file_close(TeaState* T)
 {
     int count = tea_get_top(T);
@@ -228,19 +823,127 @@ static void file_close(TeaState* T)
 
     fclose(file->file);
     file->is_open = false;
+    tea_file_unmap(file);
+
+    if(file->buffer != NULL)
+    {
+        TEA_FREE_ARRAY(T, char, file->buffer, file->buffer_size + 1);
+    }
+    file->buffer = NULL;
+    file->buffer_size = 0;
+    file->buffer_start = file->buffer_end = 0;
     
     tea_push_null(T);
 }
 
+/* Each line is its own iterator state, null ends the loop */
 static void file_iterate(TeaState* T)
 {
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+
+    tea_set_top(T, 1);
     file_readline(T);
 }
 
 static void file_iteratorvalue(TeaState* T)
 {
     int count = tea_get_top(T);
-    tea_check_args(T, count != 2, "Expected 2 arguments, got %d", count);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+}
+
+static void file_len(TeaState* T)
+{
+    tea_push_number(T, get_map(T)->map_size);
+}
+
+/* Clamps a byte offset into the mapping, negative offsets count from the end */
+static size_t map_offset(TeaState* T, TeaObjectFile* file, int index)
+{
+    double offset = tea_check_number(T, index);
+    if(offset < 0)
+        offset += file->map_size;
+    if(offset < 0)
+        return 0;
+    return offset > file->map_size ? file->map_size : (size_t)offset;
+}
+
+static void file_slice(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 3, "Expected 1 or 2 arguments, got %d", count - 1);
+
+    TeaObjectFile* file = get_map(T);
+    size_t start = map_offset(T, file, 1);
+    size_t end = count == 3 ? map_offset(T, file, 2) : file->map_size;
+
+    push_view(T, file->map + start, end > start ? end - start : 0);
+}
+
+/* First occurrence of needle at or after from, or NULL */
+static const char* map_search(const char* from, const char* end, const char* needle, size_t len)
+{
+    if(len == 0)
+        return from;
+
+    while((size_t)(end - from) >= len)
+    {
+        from = memchr(from, needle[0], (end - from) - len + 1);
+        if(from == NULL)
+            return NULL;
+        if(memcmp(from, needle, len) == 0)
+            return from;
+        from++;
+    }
+    return NULL;
+}
+
+static void file_find(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 3, "Expected 1 or 2 arguments, got %d", count - 1);
+
+    TeaObjectFile* file = get_map(T);
+    int len;
+    const char* needle = tea_check_lstring(T, 1, &len);
+    size_t start = count == 3 ? map_offset(T, file, 2) : 0;
+
+    const char* end = file->map + file->map_size;
+    const char* found = map_search(file->map + start, end, needle, len);
+    tea_push_number(T, found != NULL ? (double)(found - file->map) : -1);
+}
+
+static void file_split(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count > 2, "Expected 0 or 1 argument, got %d", count - 1);
+
+    TeaObjectFile* file = get_map(T);
+    int len = 1;
+    const char* sep = count == 2 ? tea_check_lstring(T, 1, &len) : " ";
+    if(len == 0)
+    {
+        tea_error(T, "Expected a non-empty separator");
+    }
+
+    TeaObjectList* list = tea_obj_new_list(T);
+    tea_vm_push(T, OBJECT_VAL(list));
+
+    const char* from = file->map;
+    const char* end = file->map + file->map_size;
+    while(true)
+    {
+        const char* found = map_search(from, end, sep, len);
+        const char* stop = found != NULL ? found : end;
+
+        push_view(T, from, stop - from);
+        tea_write_value_array(T, &list->items, T->top[-1]);
+        tea_pop(T, 1);
+
+        if(found == NULL)
+            break;
+        from = found + len;
+    }
 }
 
 static const TeaClass file_class[] = {
@@ -251,7 +954,14 @@ static const TeaClass file_class[] = {
     { "writeline", "method", file_writeline },
     { "read", "method", file_read },
     { "readline", "method", file_readline },
+    { "readinto", "method", file_readinto },
     { "seek", "method", file_seek },
+    { "len", "property", file_len },
+    { "slice", "method", file_slice },
+    { "find", "method", file_find },
+    { "split", "method", file_split },
+    { "flush", "method", file_flush },
+    { "setbuffer", "method", file_setbuffer },
     { "close", "method", file_close },
     { "iterate", "method", file_iterate },
     { "iteratorvalue", "method", file_iteratorvalue },
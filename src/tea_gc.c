@@ -11,7 +11,12 @@
 #include "tea_state.h"
 #include "tea_memory.h"
 #include "tea_gc.h"
+#include "tea_core.h"
+#include "tea_map.h"
+#include "tea_set.h"
 #include "tea_compiler.h"
+#include "tea_utf.h"
+#include "tea_strfmt.h"
 
 #ifdef TEA_DEBUG_LOG_GC
 #include <stdio.h>
@@ -93,7 +98,7 @@ static void blacken_object(TeaState* T, TeaObject* object)
         case OBJ_MAP:
         {
             TeaObjectMap* map = (TeaObjectMap*)object;
-            for(int i = 0; i < map->capacity; i++)
+            for(int i = 0; i < map->used; i++)
             {
                 TeaMapItem* item = &map->items[i];
                 tea_gc_mark_value(T, item->key);
@@ -101,6 +106,15 @@ static void blacken_object(TeaState* T, TeaObject* object)
             }
             break;
         }
+        case OBJ_SET:
+        {
+            TeaObjectSet* set = (TeaObjectSet*)object;
+            for(int i = 0; i < set->used; i++)
+            {
+                tea_gc_mark_value(T, set->items[i]);
+            }
+            break;
+        }
         case OBJ_BOUND_METHOD:
         {
             TeaObjectBoundMethod* bound = (TeaObjectBoundMethod*)object;
@@ -149,6 +163,20 @@ static void blacken_object(TeaState* T, TeaObject* object)
             tea_gc_mark_value(T, ((TeaObjectUpvalue*)object)->closed);
             break;
         }
+        case OBJ_BUFFER:
+        {
+            tea_gc_mark_object(T, (TeaObject*)((TeaObjectBuffer*)object)->owner);
+            break;
+        }
+        case OBJ_ITERATOR:
+        {
+            TeaObjectIterator* iterator = (TeaObjectIterator*)object;
+            tea_gc_mark_value(T, iterator->source);
+            tea_gc_mark_value(T, iterator->fn);
+            tea_gc_mark_value(T, iterator->state);
+            tea_gc_mark_value(T, iterator->value);
+            break;
+        }
         case OBJ_USERDATA:
         case OBJ_NATIVE:
         case OBJ_STRING:
@@ -170,6 +198,18 @@ static void free_object(TeaState* T, TeaObject* object)
             TEA_FREE(T, TeaObjectRange, object);
             break;
         }
+        case OBJ_ITERATOR:
+        {
+            TEA_FREE(T, TeaObjectIterator, object);
+            break;
+        }
+        case OBJ_BUFFER:
+        {
+            TeaObjectBuffer* buffer = (TeaObjectBuffer*)object;
+            TEA_FREE_ARRAY(T, uint8_t, buffer->bytes, buffer->capacity);
+            TEA_FREE(T, TeaObjectBuffer, object);
+            break;
+        }
         case OBJ_FILE:
         {
             TeaObjectFile* file = (TeaObjectFile*)object;
@@ -177,6 +217,8 @@ static void free_object(TeaState* T, TeaObject* object)
             {
                 fclose(file->file);
             }
+            TEA_FREE_ARRAY(T, char, file->buffer, file->buffer != NULL ? file->buffer_size + 1 : 0);
+            tea_file_unmap(file);
             TEA_FREE(T, TeaObjectFile, object);
             break;
         }
@@ -197,10 +239,17 @@ static void free_object(TeaState* T, TeaObject* object)
         case OBJ_MAP:
         {
             TeaObjectMap* map = (TeaObjectMap*)object;
-            TEA_FREE_ARRAY(T, TeaMapItem, map->items, map->capacity);
+            tea_map_clear(T, map);
             TEA_FREE(T, TeaObjectMap, object);
             break;
         }
+        case OBJ_SET:
+        {
+            TeaObjectSet* set = (TeaObjectSet*)object;
+            tea_set_clear(T, set);
+            TEA_FREE(T, TeaObjectSet, object);
+            break;
+        }
         case OBJ_BOUND_METHOD:
         {
             TEA_FREE(T, TeaObjectBoundMethod, object);
@@ -238,6 +287,8 @@ static void free_object(TeaState* T, TeaObject* object)
         case OBJ_STRING:
         {
             TeaObjectString* string = (TeaObjectString*)object;
+            tea_utf_free_index(T, string);
+            tea_strfmt_free(T, string);
             TEA_FREE_ARRAY(T, char, string->chars, string->length + 1);
             TEA_FREE(T, TeaObjectString, object);
             break;
@@ -285,15 +336,31 @@ static void mark_roots(TeaState* T)
 
     tea_table_mark(T, &T->modules);
     tea_table_mark(T, &T->globals);
+    tea_event_mark(T);
 
     tea_gc_mark_object(T, (TeaObject*)T->list_class);
     tea_gc_mark_object(T, (TeaObject*)T->map_class);
+    tea_gc_mark_object(T, (TeaObject*)T->set_class);
+    tea_gc_mark_object(T, (TeaObject*)T->iter_class);
+    tea_gc_mark_object(T, (TeaObject*)T->buffer_class);
     tea_gc_mark_object(T, (TeaObject*)T->string_class);
     tea_gc_mark_object(T, (TeaObject*)T->range_class);
     tea_gc_mark_object(T, (TeaObject*)T->file_class);
+    tea_gc_mark_object(T, (TeaObject*)T->stdin_file);
     
     tea_gc_mark_object(T, (TeaObject*)T->constructor_string);
     tea_gc_mark_object(T, (TeaObject*)T->repl_string);
+    tea_gc_mark_object(T, (TeaObject*)T->iterate_string);
+    tea_gc_mark_object(T, (TeaObject*)T->iteratorvalue_string);
+
+    for(int i = 0; i < UINT8_COUNT; i++)
+    {
+        tea_gc_mark_object(T, (TeaObject*)T->char_strings[i]);
+    }
+    for(int i = 0; i < NUMBER_CACHE_SIZE; i++)
+    {
+        tea_gc_mark_object(T, (TeaObject*)T->number_strings[i]);
+    }
 
     if(T->compiler != NULL)
     {
@@ -350,7 +417,7 @@ TEA_API void tea_gc(TeaState* T)
 
     mark_roots(T);
     trace_references(T);
-    tea_table_remove_white(&T->strings);
+    tea_table_remove_white(T, &T->strings);
     sweep(T);
 
     T->next_gc = T->bytes_allocated * GC_HEAP_GROW_FACTOR;
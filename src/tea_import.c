@@ -23,6 +23,10 @@ static const TeaReg modules[] = {
     { TEA_SYS_MODULE, tea_import_sys },
     { TEA_IO_MODULE, tea_import_io },
     { TEA_RANDOM_MODULE, tea_import_random },
+    { TEA_EVENT_MODULE, tea_import_event },
+    { TEA_SOCKET_MODULE, tea_import_socket },
+    { TEA_JSON_MODULE, tea_import_json },
+    { TEA_CSV_MODULE, tea_import_csv },
     { NULL, NULL }
 };
 
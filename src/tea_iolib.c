@@ -18,9 +18,17 @@
 
 static void create_stdfile(TeaState* T, FILE* f, const char* name, const char* mode)
 {
-    TeaObjectFile* file = tea_obj_new_file(T, tea_string_literal(T, ""), tea_string_new(T, mode));
-    file->file = f;
-    file->is_open = -1;
+    TeaObjectFile* file;
+    if(f == stdin)
+    {
+        file = tea_file_stdin(T);
+    }
+    else
+    {
+        file = tea_obj_new_file(T, tea_string_literal(T, ""), tea_string_new(T, mode));
+        file->file = f;
+        file->is_open = -1;
+    }
 
     tea_vm_push(T, OBJECT_VAL(file));
     tea_set_key(T, 0, name);
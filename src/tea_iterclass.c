@@ -0,0 +1,368 @@
+/*
+** tea_iterclass.c
+** Teascript iterator class
+*/
+
+#include <math.h>
+
+#define tea_iterclass_c
+#define TEA_CORE
+
+#include "tea_vm.h"
+#include "tea_do.h"
+#include "tea_core.h"
+
+/* Calls the iteration method name of a sequence, leaving the result on the stack */
+static void call_protocol(TeaState* T, TeaValue sequence, TeaObjectString* name, TeaValue arg)
+{
+    TeaObjectClass* klass = IS_INSTANCE(sequence) ? AS_INSTANCE(sequence)->klass : tea_state_get_class(T, sequence);
+    TeaValue method;
+    if(klass == NULL || !tea_table_get(&klass->methods, name, &method))
+    {
+        tea_error(T, "%s is not iterable", tea_value_type(sequence));
+    }
+
+    tea_vm_push(T, sequence);
+    tea_vm_push(T, arg);
+    tea_do_call(T, method, 1);
+}
+
+/* Lists and ranges are walked directly, anything else through the for-in protocol */
+static bool source_next(TeaState* T, TeaObjectIterator* iterator)
+{
+    TeaValue source = iterator->source;
+
+    if(IS_LIST(source))
+    {
+        TeaObjectList* list = AS_LIST(source);
+        if(iterator->count >= list->items.count)
+            return false;
+
+        iterator->value = list->items.values[(int)iterator->count++];
+        return true;
+    }
+
+    if(IS_RANGE(source))
+    {
+        TeaObjectRange* range = AS_RANGE(source);
+        double step = fabs(range->step);
+        if(step == 0) step = 1;
+
+        double i;
+        if(range->start <= range->end)
+        {
+            i = range->start + iterator->count * step;
+            if(i >= range->end)
+                return false;
+        }
+        else
+        {
+            i = range->start - iterator->count * step;
+            if(i <= range->end)
+                return false;
+        }
+
+        iterator->count++;
+        iterator->value = NUMBER_VAL(i);
+        return true;
+    }
+
+    call_protocol(T, source, T->iterate_string, iterator->state);
+    iterator->state = tea_vm_pop(T, 1);
+    if(IS_NULL(iterator->state))
+        return false;
+
+    call_protocol(T, source, T->iteratorvalue_string, iterator->state);
+    iterator->value = tea_vm_pop(T, 1);
+    return true;
+}
+
+/* Calls fn with one argument and returns its result */
+static TeaValue call_fn(TeaState* T, TeaValue fn, TeaValue arg)
+{
+    tea_vm_push(T, fn);
+    tea_vm_push(T, arg);
+    tea_do_call(T, fn, 1);
+    return tea_vm_pop(T, 1);
+}
+
+/* Pulls the next item into iterator->value, returns false once exhausted */
+static bool iter_next(TeaState* T, TeaObjectIterator* iterator)
+{
+    if(iterator->done)
+        return false;
+
+    TeaObjectIterator* up = iterator->kind == ITER_SOURCE ? NULL : AS_ITERATOR(iterator->source);
+
+    switch(iterator->kind)
+    {
+        case ITER_SOURCE:
+        {
+            if(!source_next(T, iterator))
+                break;
+            return true;
+        }
+        case ITER_MAP:
+        {
+            if(!iter_next(T, up))
+                break;
+            iterator->value = call_fn(T, iterator->fn, up->value);
+            return true;
+        }
+        case ITER_FILTER:
+        {
+            while(iter_next(T, up))
+            {
+                if(!tea_obj_isfalse(call_fn(T, iterator->fn, up->value)))
+                {
+                    iterator->value = up->value;
+                    return true;
+                }
+            }
+            break;
+        }
+        case ITER_TAKE:
+        {
+            /* Stop before pulling past the limit */
+            if(iterator->count >= iterator->n || !iter_next(T, up))
+                break;
+            iterator->count++;
+            iterator->value = up->value;
+            return true;
+        }
+        case ITER_SKIP:
+        {
+            for(; iterator->count < iterator->n; iterator->count++)
+            {
+                if(!iter_next(T, up))
+                    goto done;
+            }
+            if(!iter_next(T, up))
+                break;
+            iterator->value = up->value;
+            return true;
+        }
+        case ITER_ZIP:
+        {
+            TeaObjectIterator* other = AS_ITERATOR(iterator->fn);
+            if(!iter_next(T, up))
+                break;
+
+            /* Both sides may be the same iterator, so keep this value before advancing other */
+            tea_vm_push(T, up->value);
+            if(!iter_next(T, other))
+            {
+                tea_vm_pop(T, 1);
+                break;
+            }
+
+            TeaObjectList* pair = tea_obj_new_list(T);
+            tea_vm_push(T, OBJECT_VAL(pair));
+            tea_write_value_array(T, &pair->items, T->top[-2]);
+            tea_write_value_array(T, &pair->items, other->value);
+            iterator->value = tea_vm_pop(T, 1);
+            tea_vm_pop(T, 1);
+            return true;
+        }
+        case ITER_ENUMERATE:
+        {
+            if(!iter_next(T, up))
+                break;
+
+            TeaObjectList* pair = tea_obj_new_list(T);
+            tea_vm_push(T, OBJECT_VAL(pair));
+            tea_write_value_array(T, &pair->items, NUMBER_VAL(iterator->count));
+            tea_write_value_array(T, &pair->items, up->value);
+            iterator->count++;
+            iterator->value = tea_vm_pop(T, 1);
+            return true;
+        }
+        case ITER_CHUNK:
+        {
+            TeaObjectList* chunk = tea_obj_new_list(T);
+            tea_vm_push(T, OBJECT_VAL(chunk));
+            while(chunk->items.count < iterator->n && iter_next(T, up))
+            {
+                tea_write_value_array(T, &chunk->items, up->value);
+            }
+            iterator->value = tea_vm_pop(T, 1);
+            if(chunk->items.count == 0)
+                break;
+            return true;
+        }
+    }
+
+done:
+    iterator->done = true;
+    iterator->value = NULL_VAL;
+    return false;
+}
+
+/* Wraps the value at index in a source stage unless it already is an iterator */
+static TeaObjectIterator* check_iterable(TeaState* T, int index)
+{
+    TeaValue value = T->base[index];
+    if(IS_ITERATOR(value))
+        return AS_ITERATOR(value);
+
+    if(!IS_LIST(value) && !IS_RANGE(value))
+    {
+        TeaObjectClass* klass = IS_INSTANCE(value) ? AS_INSTANCE(value)->klass : tea_state_get_class(T, value);
+        TeaValue method;
+        if(klass == NULL || !tea_table_get(&klass->methods, T->iterate_string, &method))
+        {
+            tea_error(T, "%s is not iterable", tea_value_type(value));
+        }
+    }
+
+    TeaObjectIterator* iterator = tea_obj_new_iterator(T, ITER_SOURCE, value);
+    T->base[index] = OBJECT_VAL(iterator);
+    return iterator;
+}
+
+/* Pushes a new stage pulling from self */
+static TeaObjectIterator* push_stage(TeaState* T, TeaIteratorKind kind)
+{
+    TeaObjectIterator* iterator = tea_obj_new_iterator(T, kind, T->base[0]);
+    tea_vm_push(T, OBJECT_VAL(iterator));
+    return iterator;
+}
+
+static double check_size(TeaState* T, int index, double min)
+{
+    double n = tea_check_number(T, index);
+    if(n < min)
+    {
+        tea_error(T, "Expected a number of at least %d", (int)min);
+    }
+    return n;
+}
+
+static void iter_constructor(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+
+    TeaObjectIterator* iterator = check_iterable(T, 1);
+    tea_vm_push(T, OBJECT_VAL(iterator));
+}
+
+static void iter_map(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    tea_check_function(T, 1);
+
+    push_stage(T, ITER_MAP)->fn = T->base[1];
+}
+
+static void iter_filter(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    tea_check_function(T, 1);
+
+    push_stage(T, ITER_FILTER)->fn = T->base[1];
+}
+
+static void iter_take(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    double n = check_size(T, 1, 0);
+
+    push_stage(T, ITER_TAKE)->n = n;
+}
+
+static void iter_skip(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    double n = check_size(T, 1, 0);
+
+    push_stage(T, ITER_SKIP)->n = n;
+}
+
+static void iter_zip(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    TeaObjectIterator* other = check_iterable(T, 1);
+
+    push_stage(T, ITER_ZIP)->fn = OBJECT_VAL(other);
+}
+
+static void iter_enumerate(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 0 arguments, got %d", count - 1);
+
+    push_stage(T, ITER_ENUMERATE);
+}
+
+static void iter_chunk(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    double n = check_size(T, 1, 1);
+
+    push_stage(T, ITER_CHUNK)->n = n;
+}
+
+static void iter_collect(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 0 arguments, got %d", count - 1);
+
+    TeaObjectIterator* iterator = AS_ITERATOR(T->base[0]);
+    TeaObjectList* list = tea_obj_new_list(T);
+    tea_vm_push(T, OBJECT_VAL(list));
+    while(iter_next(T, iterator))
+    {
+        tea_write_value_array(T, &list->items, iterator->value);
+    }
+}
+
+/* Iterators are single pass, each step of a for-in loop pulls one item */
+static void iter_iterate(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    TeaObjectIterator* iterator = AS_ITERATOR(T->base[0]);
+    if(iter_next(T, iterator))
+        tea_push_number(T, iterator->count);
+    else
+        tea_push_null(T);
+}
+
+static void iter_iteratorvalue(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    tea_vm_push(T, AS_ITERATOR(T->base[0])->value);
+}
+
+static const TeaClass iter_class[] = {
+    { "constructor", "method", iter_constructor },
+    { "map", "method", iter_map },
+    { "filter", "method", iter_filter },
+    { "take", "method", iter_take },
+    { "skip", "method", iter_skip },
+    { "zip", "method", iter_zip },
+    { "enumerate", "method", iter_enumerate },
+    { "chunk", "method", iter_chunk },
+    { "collect", "method", iter_collect },
+    { "iterate", "method", iter_iterate },
+    { "iteratorvalue", "method", iter_iteratorvalue },
+    { NULL, NULL, NULL }
+};
+
+void tea_open_iter(TeaState* T)
+{
+    tea_create_class(T, TEA_ITER_CLASS, iter_class);
+    T->iter_class = AS_CLASS(T->top[-1]);
+    tea_set_global(T, TEA_ITER_CLASS);
+    tea_push_null(T);
+}
@@ -0,0 +1,892 @@
+/*
+** tea_jsonlib.c
+** Teascript json module
+**
+** Parsing is a single pass that builds lists, maps and strings straight on
+** the stack. String bodies and the spans to escape are found eight bytes at
+** a time, numbers go through the shared number scanner
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define tea_jsonlib_c
+#define TEA_LIB
+
+#include "tea.h"
+#include "tealib.h"
+
+#include "tea_import.h"
+#include "tea_core.h"
+#include "tea_state.h"
+#include "tea_string.h"
+#include "tea_memory.h"
+#include "tea_map.h"
+#include "tea_vm.h"
+#include "tea_do.h"
+#include "tea_strscan.h"
+#include "tea_strfmt.h"
+#include "tea_utf.h"
+
+/* Deepest nesting of lists and maps read or written */
+#define JSON_MAX_DEPTH 512
+
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+/* Non zero when any byte of w is below n, for n up to 128 */
+#define HAS_LESS(w, n) (((w) - ONES * (n)) & ~(w) & HIGHS)
+
+/* Non zero when any byte of w equals c */
+#define HAS_BYTE(w, c) HAS_LESS((w) ^ (ONES * (c)), 1)
+
+/* Skips bytes that need no escaping, stopping at a quote, backslash or control character */
+static const char* json_scan(const char* p, const char* end)
+{
+    while(end - p >= 8)
+    {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        if(HAS_BYTE(w, '"') | HAS_BYTE(w, '\\') | HAS_LESS(w, 0x20))
+            break;
+        p += 8;
+    }
+    while(p < end && *p != '"' && *p != '\\' && (uint8_t)*p >= 0x20)
+    {
+        p++;
+    }
+    return p;
+}
+
+typedef enum
+{
+    JSON_OK,
+    JSON_ERROR,
+    JSON_MORE   /* Ran out of input that may still be coming */
+} JsonStatus;
+
+typedef struct
+{
+    TeaState* T;
+    const char* start;
+    const char* p;
+    const char* end;
+    bool more;          /* The input may continue past end */
+    int depth;
+    const char* error;
+    char* chars;        /* Scratch space for strings with escapes */
+    int chars_size;
+} JsonParser;
+
+static JsonStatus fail(JsonParser* ps, const char* error)
+{
+    if(ps->p >= ps->end && ps->more)
+        return JSON_MORE;
+    ps->error = error;
+    return JSON_ERROR;
+}
+
+static void skip_space(JsonParser* ps)
+{
+    const char* p = ps->p;
+    while(p < ps->end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+    {
+        p++;
+    }
+    ps->p = p;
+}
+
+static JsonStatus parse_value(JsonParser* ps);
+
+static JsonStatus parse_literal(JsonParser* ps, const char* word, int len, TeaValue value)
+{
+    int left = ps->end - ps->p;
+    if(memcmp(ps->p, word, left < len ? left : len) != 0)
+        return fail(ps, "Unexpected character");
+    if(left < len)
+    {
+        ps->p = ps->end;
+        return fail(ps, "Unexpected end of input");
+    }
+    ps->p += len;
+    tea_vm_push(ps->T, value);
+    return JSON_OK;
+}
+
+static bool json_isdigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static JsonStatus parse_number(JsonParser* ps)
+{
+    const char* start = ps->p;
+    const char* p = start;
+    const char* end = ps->end;
+
+    if(p < end && *p == '-')
+        p++;
+    if(p < end && *p == '0')
+    {
+        p++;
+    }
+    else
+    {
+        if(p >= end || !json_isdigit(*p))
+            goto invalid;
+        while(p < end && json_isdigit(*p))
+            p++;
+    }
+    if(p < end && *p == '.')
+    {
+        p++;
+        if(p >= end || !json_isdigit(*p))
+            goto invalid;
+        while(p < end && json_isdigit(*p))
+            p++;
+    }
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        if(p < end && (*p == '+' || *p == '-'))
+            p++;
+        if(p >= end || !json_isdigit(*p))
+            goto invalid;
+        while(p < end && json_isdigit(*p))
+            p++;
+    }
+
+    /* More digits may follow in the next read */
+    if(p >= end && ps->more)
+        return JSON_MORE;
+
+    double n;
+    if(!tea_strscan_number(start, p - start, &n))
+    {
+        ps->p = p;
+        return fail(ps, "Invalid number");
+    }
+    ps->p = p;
+    tea_vm_push(ps->T, NUMBER_VAL(n));
+    return JSON_OK;
+
+invalid:
+    ps->p = p;
+    return fail(ps, "Invalid number");
+}
+
+static int hex4(const char* p)
+{
+    int v = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        char c = p[i];
+        v <<= 4;
+        if(c >= '0' && c <= '9')
+            v |= c - '0';
+        else if(c >= 'a' && c <= 'f')
+            v |= c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            v |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return v;
+}
+
+/* Reads a \u escape, and the low half that has to follow a high surrogate */
+static JsonStatus parse_unicode(JsonParser* ps, int* value)
+{
+    if(ps->end - ps->p < 6)
+    {
+        ps->p = ps->end;
+        return fail(ps, "Unexpected end of input");
+    }
+    int cp = hex4(ps->p + 2);
+    if(cp < 0)
+        return fail(ps, "Invalid unicode escape");
+    ps->p += 6;
+
+    if(cp >= 0xd800 && cp <= 0xdbff)
+    {
+        if(ps->end - ps->p < 6)
+        {
+            ps->p = ps->end;
+            return fail(ps, "Unexpected end of input");
+        }
+        int low = ps->p[0] == '\\' && ps->p[1] == 'u' ? hex4(ps->p + 2) : -1;
+        if(low < 0xdc00 || low > 0xdfff)
+            return fail(ps, "Invalid unicode surrogate");
+        ps->p += 6;
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+    }
+    else if(cp >= 0xdc00 && cp <= 0xdfff)
+    {
+        return fail(ps, "Invalid unicode surrogate");
+    }
+
+    *value = cp;
+    return JSON_OK;
+}
+
+static void reserve(JsonParser* ps, int len, int more)
+{
+    if(len + more > ps->chars_size)
+    {
+        int old_size = ps->chars_size;
+        int new_size = old_size < 64 ? 64 : old_size;
+        while(new_size < len + more)
+            new_size *= 2;
+        ps->chars = TEA_GROW_ARRAY(ps->T, char, ps->chars, old_size, new_size);
+        ps->chars_size = new_size;
+    }
+}
+
+static JsonStatus parse_string(JsonParser* ps)
+{
+    /* Skip the opening quote */
+    const char* start = ++ps->p;
+    const char* p = json_scan(start, ps->end);
+
+    /* Strings without escapes are interned straight from the input */
+    if(p < ps->end && *p == '"')
+    {
+        ps->p = p + 1;
+        tea_vm_push(ps->T, OBJECT_VAL(tea_string_copy(ps->T, start, p - start)));
+        return JSON_OK;
+    }
+
+    int len = 0;
+    while(true)
+    {
+        if(p > start)
+        {
+            reserve(ps, len, p - start);
+            memcpy(ps->chars + len, start, p - start);
+            len += p - start;
+        }
+        ps->p = p;
+
+        if(p >= ps->end)
+            return fail(ps, "Unterminated string");
+        if(*p == '"')
+            break;
+        if(*p != '\\')
+            return fail(ps, "Invalid character in string");
+
+        if(ps->end - p < 2)
+        {
+            ps->p = ps->end;
+            return fail(ps, "Unterminated string");
+        }
+
+        char c;
+        switch(p[1])
+        {
+            case '"': c = '"'; break;
+            case '\\': c = '\\'; break;
+            case '/': c = '/'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u':
+            {
+                int cp;
+                JsonStatus status = parse_unicode(ps, &cp);
+                if(status != JSON_OK)
+                    return status;
+                reserve(ps, len, 4);
+                len += tea_utf_encode(cp, (uint8_t*)ps->chars + len);
+                start = ps->p;
+                p = json_scan(start, ps->end);
+                continue;
+            }
+            default:
+                ps->p = p + 1;
+                return fail(ps, "Invalid escape");
+        }
+
+        reserve(ps, len, 1);
+        ps->chars[len++] = c;
+        start = p + 2;
+        p = json_scan(start, ps->end);
+    }
+
+    ps->p++;
+    tea_vm_push(ps->T, OBJECT_VAL(tea_string_copy(ps->T, ps->chars, len)));
+    return JSON_OK;
+}
+
+static JsonStatus parse_list(JsonParser* ps)
+{
+    TeaState* T = ps->T;
+    TeaObjectList* list = tea_obj_new_list(T);
+    tea_vm_push(T, OBJECT_VAL(list));
+    ps->p++;
+
+    skip_space(ps);
+    if(ps->p < ps->end && *ps->p == ']')
+    {
+        ps->p++;
+        return JSON_OK;
+    }
+
+    while(true)
+    {
+        JsonStatus status = parse_value(ps);
+        if(status != JSON_OK)
+            return status;
+        tea_write_value_array(T, &list->items, T->top[-1]);
+        T->top--;
+
+        skip_space(ps);
+        if(ps->p >= ps->end)
+            return fail(ps, "Unterminated list");
+        if(*ps->p == ']')
+        {
+            ps->p++;
+            return JSON_OK;
+        }
+        if(*ps->p != ',')
+            return fail(ps, "Expected ',' or ']'");
+        ps->p++;
+    }
+}
+
+static JsonStatus parse_map(JsonParser* ps)
+{
+    TeaState* T = ps->T;
+    TeaObjectMap* map = tea_map_new(T);
+    tea_vm_push(T, OBJECT_VAL(map));
+    ps->p++;
+
+    skip_space(ps);
+    if(ps->p < ps->end && *ps->p == '}')
+    {
+        ps->p++;
+        return JSON_OK;
+    }
+
+    while(true)
+    {
+        skip_space(ps);
+        if(ps->p >= ps->end)
+            return fail(ps, "Unterminated map");
+        if(*ps->p != '"')
+            return fail(ps, "Expected a string key");
+
+        JsonStatus status = parse_string(ps);
+        if(status != JSON_OK)
+            return status;
+
+        skip_space(ps);
+        if(ps->p >= ps->end)
+            return fail(ps, "Unterminated map");
+        if(*ps->p != ':')
+            return fail(ps, "Expected ':'");
+        ps->p++;
+
+        status = parse_value(ps);
+        if(status != JSON_OK)
+            return status;
+        tea_map_set(T, map, T->top[-2], T->top[-1]);
+        T->top -= 2;
+
+        skip_space(ps);
+        if(ps->p >= ps->end)
+            return fail(ps, "Unterminated map");
+        if(*ps->p == '}')
+        {
+            ps->p++;
+            return JSON_OK;
+        }
+        if(*ps->p != ',')
+            return fail(ps, "Expected ',' or '}'");
+        ps->p++;
+    }
+}
+
+/* Pushes the next value */
+static JsonStatus parse_value(JsonParser* ps)
+{
+    skip_space(ps);
+    if(ps->p >= ps->end)
+        return fail(ps, "Unexpected end of input");
+
+    switch(*ps->p)
+    {
+        case '"':
+            return parse_string(ps);
+        case '[':
+        case '{':
+        {
+            if(++ps->depth > JSON_MAX_DEPTH)
+                return fail(ps, "Too deeply nested");
+
+            /* Room for the container, a key and a value */
+            teaD_checkstack(ps->T, 3);
+            JsonStatus status = *ps->p == '[' ? parse_list(ps) : parse_map(ps);
+            ps->depth--;
+            return status;
+        }
+        case 't':
+            return parse_literal(ps, "true", 4, TRUE_VAL);
+        case 'f':
+            return parse_literal(ps, "false", 5, FALSE_VAL);
+        case 'n':
+            return parse_literal(ps, "null", 4, NULL_VAL);
+        default:
+            if(*ps->p == '-' || json_isdigit(*ps->p))
+                return parse_number(ps);
+            return fail(ps, "Unexpected character");
+    }
+}
+
+static void init_parser(JsonParser* ps, TeaState* T, const char* chars, size_t len, bool more)
+{
+    ps->T = T;
+    ps->start = ps->p = chars;
+    ps->end = chars + len;
+    ps->more = more;
+    ps->depth = 0;
+    ps->error = NULL;
+    ps->chars = NULL;
+    ps->chars_size = 0;
+}
+
+/* Parses one value leaving it pushed, the stack is put back when it fails */
+static JsonStatus parse(JsonParser* ps)
+{
+    TeaState* T = ps->T;
+    ptrdiff_t top = savestack(T, T->top);
+
+    JsonStatus status = parse_value(ps);
+    TEA_FREE_ARRAY(T, char, ps->chars, ps->chars_size);
+    ps->chars = NULL;
+    ps->chars_size = 0;
+
+    if(status != JSON_OK)
+    {
+        T->top = restorestack(T, top);
+    }
+    return status;
+}
+
+static void parse_error(JsonParser* ps)
+{
+    tea_error(ps->T, "%s at offset %d", ps->error, (int)(ps->p - ps->start));
+}
+
+/* parse(text) reads a string or buffer holding one JSON value */
+static void json_parse(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    int len;
+    const char* chars = tea_is_buffer(T, 0) ? tea_to_buffer(T, 0, &len) : tea_check_lstring(T, 0, &len);
+
+    JsonParser ps;
+    init_parser(&ps, T, chars, len, false);
+    if(parse(&ps) != JSON_OK)
+        parse_error(&ps);
+
+    skip_space(&ps);
+    if(ps.p < ps.end)
+    {
+        ps.error = "Unexpected data after the value";
+        parse_error(&ps);
+    }
+}
+
+/* How far a value read from a file has been looked over, kept across fills */
+typedef struct
+{
+    int depth;
+    bool string;
+    bool escape;
+    bool scalar;
+    bool done;
+    size_t scanned;
+} JsonBounds;
+
+/*
+** Looks over the bytes added since the last call, returns true once the
+** value may be whole. The parse waits for that, so a value spread over many
+** fills is looked at once more per fill instead of parsed again each time
+*/
+static bool json_bounds(JsonBounds* b, const char* start, const char* end)
+{
+    const char* p = start + b->scanned;
+    bool done = b->done;
+    while(p < end && !done)
+    {
+        char c = *p++;
+        if(b->string)
+        {
+            if(b->escape)
+            {
+                b->escape = false;
+            }
+            else if(c == '\\')
+            {
+                b->escape = true;
+            }
+            else if(c == '"')
+            {
+                b->string = false;
+                done = b->depth == 0;
+            }
+            else
+            {
+                p = json_scan(p, end);
+            }
+            continue;
+        }
+
+        /* A number or word at the top ends at the first byte that is not part of it */
+        bool word = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            c == '+' || c == '-' || c == '.';
+        if(b->scalar && !word)
+        {
+            done = true;
+            break;
+        }
+
+        switch(c)
+        {
+            case '"':
+                b->string = true;
+                p = json_scan(p, end);
+                break;
+            case '[':
+            case '{':
+                b->depth++;
+                break;
+            case ']':
+            case '}':
+                done = --b->depth <= 0;
+                break;
+            default:
+                if(word && b->depth == 0)
+                    b->scalar = true;
+                break;
+        }
+    }
+    b->scanned = p - start;
+    b->done = done;
+    return done;
+}
+
+/*
+** read(file) parses the next value in the file, null once only whitespace
+** is left. Values can follow each other, as in newline delimited JSON, and
+** only as much of the file as the value needs is read
+*/
+static void json_read(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    tea_check_file(T, 0);
+    TeaObjectFile* file = AS_FILE(T->base[0]);
+    if(!file->is_open || strcmp(file->type->chars, "w") == 0)
+    {
+        tea_error(T, "File is not readable");
+    }
+
+    JsonParser ps;
+    if(file->map != NULL)
+    {
+        init_parser(&ps, T, file->map + file->map_pos, file->map_size - file->map_pos, false);
+        skip_space(&ps);
+        file->map_pos += ps.p - ps.start;
+        if(ps.p == ps.end)
+        {
+            tea_push_null(T);
+            return;
+        }
+        if(parse(&ps) != JSON_OK)
+            parse_error(&ps);
+        file->map_pos += ps.p - (file->map + file->map_pos);
+        return;
+    }
+
+    JsonBounds bounds = { 0, false, false, false, false, 0 };
+    bool more = true;
+    while(true)
+    {
+        if(file->buffer != NULL)
+        {
+            init_parser(&ps, T, file->buffer + file->buffer_start, file->buffer_end - file->buffer_start, more);
+            if(bounds.scanned == 0)
+            {
+                skip_space(&ps);
+                file->buffer_start += ps.p - ps.start;
+            }
+
+            if(ps.p < ps.end)
+            {
+                if(!more || json_bounds(&bounds, ps.p, ps.end))
+                {
+                    JsonStatus status = parse(&ps);
+                    if(status == JSON_OK)
+                    {
+                        file->buffer_start += ps.p - (file->buffer + file->buffer_start);
+                        return;
+                    }
+                    if(status == JSON_ERROR)
+                        parse_error(&ps);
+                }
+            }
+            else if(!more)
+            {
+                tea_push_null(T);
+                return;
+            }
+        }
+
+        /* Whatever is buffered is not a whole value yet */
+        more = tea_file_fill(T, file) > 0;
+    }
+}
+
+typedef struct
+{
+    TeaState* T;
+    char* chars;
+    int len;
+    int size;
+    int indent;
+    int depth;
+} JsonWriter;
+
+static void grow(JsonWriter* w, int more)
+{
+    if(w->len + more > w->size)
+    {
+        int old_size = w->size;
+        int new_size = old_size < 256 ? 256 : old_size;
+        while(new_size < w->len + more)
+            new_size *= 2;
+        w->chars = TEA_GROW_ARRAY(w->T, char, w->chars, old_size, new_size);
+        w->size = new_size;
+    }
+}
+
+static void put(JsonWriter* w, const char* chars, int len)
+{
+    grow(w, len);
+    memcpy(w->chars + w->len, chars, len);
+    w->len += len;
+}
+
+static void put_char(JsonWriter* w, char c)
+{
+    grow(w, 1);
+    w->chars[w->len++] = c;
+}
+
+static void put_newline(JsonWriter* w)
+{
+    if(w->indent == 0)
+        return;
+
+    int n = w->depth * w->indent;
+    grow(w, n + 1);
+    w->chars[w->len++] = '\n';
+    memset(w->chars + w->len, ' ', n);
+    w->len += n;
+}
+
+static void put_string(JsonWriter* w, const char* chars, int len)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    const char* p = chars;
+    const char* end = chars + len;
+
+    put_char(w, '"');
+    while(p < end)
+    {
+        const char* run = json_scan(p, end);
+        put(w, p, run - p);
+        if(run == end)
+            break;
+
+        char c = *run;
+        switch(c)
+        {
+            case '"': put(w, "\\\"", 2); break;
+            case '\\': put(w, "\\\\", 2); break;
+            case '\b': put(w, "\\b", 2); break;
+            case '\f': put(w, "\\f", 2); break;
+            case '\n': put(w, "\\n", 2); break;
+            case '\r': put(w, "\\r", 2); break;
+            case '\t': put(w, "\\t", 2); break;
+            default:
+            {
+                char u[6] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf] };
+                put(w, u, 6);
+                break;
+            }
+        }
+        p = run + 1;
+    }
+    put_char(w, '"');
+}
+
+static void put_number(JsonWriter* w, double n)
+{
+    /* JSON has no way to write these */
+    if(isnan(n) || isinf(n))
+    {
+        put(w, "null", 4);
+        return;
+    }
+
+    grow(w, STRFMT_MAXBUF_NUM);
+    w->len += tea_strfmt_number(w->chars + w->len, n);
+}
+
+/* Returns the name of a type that cannot be written, or NULL */
+static const char* write_value(JsonWriter* w, TeaValue value)
+{
+    if(IS_NULL(value))
+    {
+        put(w, "null", 4);
+    }
+    else if(IS_BOOL(value))
+    {
+        AS_BOOL(value) ? put(w, "true", 4) : put(w, "false", 5);
+    }
+    else if(IS_NUMBER(value))
+    {
+        put_number(w, AS_NUMBER(value));
+    }
+    else if(IS_STRING(value))
+    {
+        put_string(w, AS_CSTRING(value), AS_STRING(value)->length);
+    }
+    else if(IS_LIST(value) || IS_MAP(value))
+    {
+        if(w->depth >= JSON_MAX_DEPTH)
+            return "lists or maps nested this deep";
+
+        bool list = IS_LIST(value);
+        put_char(w, list ? '[' : '{');
+        w->depth++;
+
+        bool first = true;
+        if(list)
+        {
+            TeaValueArray* items = &AS_LIST(value)->items;
+            for(int i = 0; i < items->count; i++)
+            {
+                if(!first)
+                    put_char(w, ',');
+                first = false;
+                put_newline(w);
+
+                const char* error = write_value(w, items->values[i]);
+                if(error != NULL)
+                    return error;
+            }
+        }
+        else
+        {
+            TeaObjectMap* map = AS_MAP(value);
+            for(int i = 0; i < map->used; i++)
+            {
+                TeaMapItem* item = &map->items[i];
+                if(MAP_ITEM_EMPTY(item))
+                    continue;
+
+                if(!first)
+                    put_char(w, ',');
+                first = false;
+                put_newline(w);
+
+                /* Number keys are written as strings, like JavaScript does */
+                if(IS_STRING(item->key))
+                {
+                    put_string(w, AS_CSTRING(item->key), AS_STRING(item->key)->length);
+                }
+                else if(IS_NUMBER(item->key))
+                {
+                    put_char(w, '"');
+                    put_number(w, AS_NUMBER(item->key));
+                    put_char(w, '"');
+                }
+                else
+                {
+                    return "map keys that are not strings";
+                }
+
+                put_char(w, ':');
+                if(w->indent > 0)
+                    put_char(w, ' ');
+
+                const char* error = write_value(w, item->value);
+                if(error != NULL)
+                    return error;
+            }
+        }
+
+        w->depth--;
+        if(!first)
+            put_newline(w);
+        put_char(w, list ? ']' : '}');
+    }
+    else
+    {
+        return tea_value_type(value);
+    }
+    return NULL;
+}
+
+/* stringify(value, indent = 0) writes value as JSON, laid out over lines when indent is given */
+static void json_stringify(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    double indent = tea_opt_number(T, 1, 0);
+    if(indent < 0 || indent > 16)
+    {
+        tea_error(T, "Expected an indent from 0 to 16");
+    }
+
+    JsonWriter w;
+    w.T = T;
+    w.chars = NULL;
+    w.len = 0;
+    w.size = 0;
+    w.indent = (int)indent;
+    w.depth = 0;
+
+    const char* error = write_value(&w, T->base[0]);
+    if(error != NULL)
+    {
+        TEA_FREE_ARRAY(T, char, w.chars, w.size);
+        tea_error(T, "Cannot write %s as JSON", error);
+    }
+
+    tea_push_lstring(T, w.chars, w.len);
+    TEA_FREE_ARRAY(T, char, w.chars, w.size);
+}
+
+static const TeaModule json_module[] = {
+    { "parse", json_parse },
+    { "read", json_read },
+    { "stringify", json_stringify },
+    { NULL, NULL }
+};
+
+TEAMOD_API void tea_import_json(TeaState* T)
+{
+    tea_create_module(T, TEA_JSON_MODULE, json_module);
+}
@@ -4,6 +4,7 @@
 */
 
 #include <math.h>
+#include <string.h>
 
 #define tea_listclass_c
 #define TEA_CORE
@@ -11,15 +12,56 @@
 #include "tea.h"
 
 #include "tea_vm.h"
+#include "tea_do.h"
 #include "tea_memory.h"
 #include "tea_core.h"
 #include "tea_string.h"
 
+#if defined(TEA_USE_PTHREADS)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 static void list_len(TeaState* T)
 {
     tea_push_number(T, tea_len(T, 0));
 }
 
+static void list_constructor(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count > 3, "Expected 0 to 2 arguments, got %d", count - 1);
+
+    tea_new_list(T);
+    if(count == 1)
+        return;
+
+    double n = tea_check_number(T, 1);
+    if(n < 0 || n > INT32_MAX)
+    {
+        tea_error(T, "Expected a size from 0 to %d", INT32_MAX);
+    }
+
+    /* list(n, fill) repeats fill n times, list(n) gives n nulls */
+    TeaValue fill = count == 3 ? T->base[2] : NULL_VAL;
+    tea_fill_value_array(T, &AS_LIST(T->top[-1])->items, fill, (int)n);
+}
+
+static void list_reserve(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+
+    double n = tea_check_number(T, 1);
+    if(n < 0 || n > INT32_MAX)
+    {
+        tea_error(T, "Expected a size from 0 to %d", INT32_MAX);
+    }
+
+    tea_reserve_value_array(T, &AS_LIST(T->base[0])->items, (int)n);
+    tea_pop(T, 1);
+}
+
 static void list_add(TeaState* T)
 {
     int count = tea_get_top(T);
@@ -27,62 +69,42 @@ static void list_add(TeaState* T)
     tea_add_item(T, 0);
 }
 
+/* Closes the slot at index from whichever end is nearer */
+static void remove_at(TeaObjectList* list, int index)
+{
+    TeaValueArray* items = &list->items;
+    if(index < items->count / 2)
+    {
+        memmove(items->values + 1, items->values, sizeof(TeaValue) * index);
+        tea_shift_value_array(items);
+    }
+    else
+    {
+        memmove(items->values + index, items->values + index + 1, sizeof(TeaValue) * (items->count - index - 1));
+        items->count--;
+    }
+}
+
 static void list_remove(TeaState* T)
 {
     int count = tea_get_top(T);
     tea_ensure_min_args(T, count, 2);
 
-    int len = tea_len(T, 0);
-
-    bool found = false;
-    if(len == 0) 
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    if(list->items.count == 0) 
     {
         tea_pop(T, 1);
         return;
     }
 
-    if(len > 1) 
+    for(int i = 0; i < list->items.count; i++)
     {
-        for(int i = 0; i < len - 1; i++) 
+        if(tea_value_equal(list->items.values[i], T->base[1]))
         {
-            tea_get_item(T, 0, i);
-            if(!found && tea_equals(T, 1, 2)) 
-            {
-                found = true;
-            }
+            remove_at(list, i);
             tea_pop(T, 1);
-
-            /* If we have found the value, shuffle the array */
-            if(found) 
-            {
-                tea_get_item(T, 0, i + 1);
-                tea_set_item(T, 0, i);
-            }
-        }
-
-        /* Check if it's the last element */
-        tea_get_item(T, 0, len - 1);
-        if(!found && tea_equals(T, 1, 2)) 
-        {
-            found = true;
-        }
-        tea_pop(T, 1);
-    } 
-    else 
-    {
-        tea_get_item(T, 0, 0);
-        if(tea_equals(T, 1, 2)) 
-        {
-            found = true;
+            return;
         }
-        tea_pop(T, 1);
-    }
-
-    if(found) 
-    {
-        AS_LIST(T->base[0])->items.count--;
-        tea_pop(T, 1);
-        return;
     }
 
     tea_error(T, "Value does not exist within the list");
@@ -93,9 +115,8 @@ static void list_delete(TeaState* T)
     int count = tea_get_top(T);
     tea_ensure_min_args(T, count, 2);
 
-    int len = tea_len(T, 0);
-
-    if(len == 0) 
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    if(list->items.count == 0) 
     {
         tea_pop(T, 1);
         return;
@@ -103,18 +124,12 @@ static void list_delete(TeaState* T)
 
     int index = tea_check_number(T, 1);
 
-    if(index < 0 || index > len)
+    if(index < 0 || index >= list->items.count)
     {
         tea_error(T, "Index out of bounds");
     }
 
-    for(int i = index; i < len - 1; i++)
-    {
-        tea_get_item(T, 0, i + 1);
-        tea_set_item(T, 0, i);
-    }
-
-    AS_LIST(T->base[0])->items.count--;
+    remove_at(list, index);
     tea_pop(T, 1);
 }
 
@@ -124,7 +139,7 @@ static void list_clear(TeaState* T)
     tea_ensure_min_args(T, count, 1);
     
     TeaObjectList* list = AS_LIST(T->base[0]);
-    tea_init_value_array(&list->items);
+    tea_free_value_array(T, &list->items);
 }
 
 static void list_insert(TeaState* T)
@@ -141,21 +156,20 @@ static void list_insert(TeaState* T)
         tea_error(T, "Index out of bounds for the list given");
     }
 
-    if(list->items.capacity < list->items.count + 1) 
+    TeaValueArray* items = &list->items;
+    if(index == 0 || (index < items->count / 2 && items->front > 0))
     {
-        int old_capacity = list->items.capacity;
-        list->items.capacity = TEA_GROW_CAPACITY(old_capacity);
-        list->items.values = TEA_GROW_ARRAY(T, TeaValue, list->items.values, old_capacity, list->items.capacity);
+        /* Open the slot by moving the front part into the gap */
+        tea_unshift_value_array(T, items, insert_value);
+        memmove(items->values, items->values + 1, sizeof(TeaValue) * index);
     }
-
-    list->items.count++;
-
-    for(int i = list->items.count - 1; i > index; --i) 
+    else
     {
-        list->items.values[i] = list->items.values[i - 1];
+        tea_write_value_array(T, items, insert_value);
+        memmove(items->values + index + 1, items->values + index, sizeof(TeaValue) * (items->count - index - 1));
     }
 
-    list->items.values[index] = insert_value;
+    items->values[index] = insert_value;
     tea_pop(T, 2);
 }
 
@@ -165,14 +179,7 @@ static void list_extend(TeaState* T)
     tea_ensure_min_args(T, count, 2);
 
     tea_check_list(T, 1);
-    int len = tea_len(T, 1);
-
-    /* list index 0, list index 1 */
-    for(int i = 0; i < len; i++) 
-    {
-        tea_get_item(T, 1, i);
-        tea_add_item(T, 0);
-    }
+    tea_append_value_array(T, &AS_LIST(T->base[0])->items, &AS_LIST(T->base[1])->items);
     tea_pop(T, 1);
 }
 
@@ -260,135 +267,553 @@ static void list_fill(TeaState* T)
     int count = tea_get_top(T);
     tea_ensure_min_args(T, count, 2);
 
-    int len = tea_len(T, 0);
-
-    for(int i = 0; i < len; i++) 
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    TeaValue value = T->base[1];
+    for(int i = 0; i < list->items.count; i++) 
     {
-        tea_push_value(T, 1);
-        tea_set_item(T, 0, i);
+        list->items.values[i] = value;
     }
     tea_pop(T, 1);
 }
 
-static void set2(TeaState* T, int i, int j)
+/* Runs shorter than this are insertion sorted before merging */
+#define SORT_RUN 32
+
+typedef struct
+{
+    TeaState* T;
+    TeaValue* keys;     /* Key mode, the sorted elements are indices into keys */
+    TeaPreparedCall* call;  /* Compare through the function in slot 1 */
+} SortState;
+
+static int compare_strings(TeaObjectString* a, TeaObjectString* b)
 {
-    tea_set_item(T, 0, i);
-    tea_set_item(T, 0, j);
+    int len = a->length < b->length ? a->length : b->length;
+    int c = memcmp(a->chars, b->chars, len);
+    return c != 0 ? c : a->length - b->length;
 }
 
-static bool sort_comp(TeaState* T, int a, int b)
+/* Natural order, numbers with numbers and strings with strings */
+static bool value_less(TeaValue a, TeaValue b)
 {
-    if(!tea_is_null(T, 1))
+    if(IS_NUMBER(a))
+        return AS_NUMBER(a) < AS_NUMBER(b);
+    return compare_strings(AS_STRING(a), AS_STRING(b)) < 0;
+}
+
+static bool sort_less(SortState* s, TeaValue a, TeaValue b)
+{
+    if(s->keys != NULL)
+    {
+        return value_less(s->keys[(int)AS_NUMBER(a)], s->keys[(int)AS_NUMBER(b)]);
+    }
+    if(s->call)
     {
-        bool res;
-        tea_push_value(T, 1);
-        tea_push_value(T, a - 1); /* -1 to compensate function */
-        tea_push_value(T, b - 2); /* -2 to compensate function and 'a' */
-        tea_call(T, 2);
-        res = tea_check_bool(T, -1);
+        TeaState* T = s->T;
+        tea_vm_push(T, s->call->func);
+        tea_vm_push(T, a);
+        tea_vm_push(T, b);
+        tea_do_prepared_call(T, s->call);
+        bool res = tea_check_bool(T, -1);
         tea_pop(T, 1);
         return res;
     }
-    else
+    return value_less(a, b);
+}
+
+static void insertion_sort(SortState* s, TeaValue* a, int lo, int hi)
+{
+    for(int i = lo + 1; i < hi; i++)
     {
-        double n1 = tea_check_number(T, a);
-        double n2 = tea_check_number(T, b);
-        return n1 < n2;
+        TeaValue v = a[i];
+        int j = i;
+        while(j > lo && sort_less(s, v, a[j - 1]))
+        {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
     }
 }
 
-static void auxsort(TeaState* T, int l, int u)
+static void merge(SortState* s, TeaValue* a, TeaValue* tmp, int lo, int mid, int hi)
 {
-    while(l < u)
+    /* Runs that are already in order need no work */
+    if(!sort_less(s, a[mid], a[mid - 1]))
+        return;
+
+    memcpy(tmp + lo, a + lo, sizeof(TeaValue) * (mid - lo));
+
+    int i = lo, j = mid, k = lo;
+    while(i < mid && j < hi)
     {
-        int i, j;
-        /* sort elements a[l], a[(l+u)/2] and a[u] */
-        tea_get_item(T, 0, l);
-        tea_get_item(T, 0, u);
-        if(sort_comp(T, -1, -2)) /* a[u] < a[l]? */
-            set2(T, l, u);        /* swap a[l] - a[u] */
-        else
-            tea_pop(T, 2);
-        if (u - l == 1)
-            break; /* only 2 elements */
-        i = (l + u) / 2;
-        tea_get_item(T, 0, i);
-        tea_get_item(T, 0, l);
-        if(sort_comp(T, -2, -1)) /* a[i]<a[l]? */
-            set2(T, i, l);
+        if(sort_less(s, a[j], tmp[i]))
+            a[k++] = a[j++];
         else
+            a[k++] = tmp[i++];
+    }
+    while(i < mid)
+        a[k++] = tmp[i++];
+}
+
+/* Stable bottom-up merge sort, tmp must hold n values */
+static void merge_sort(SortState* s, TeaValue* a, TeaValue* tmp, int n)
+{
+    for(int lo = 0; lo < n; lo += SORT_RUN)
+    {
+        insertion_sort(s, a, lo, lo + SORT_RUN < n ? lo + SORT_RUN : n);
+    }
+
+    for(int width = SORT_RUN; width < n; width *= 2)
+    {
+        for(int lo = 0; lo < n - width; lo += 2 * width)
         {
-            tea_pop(T, 1); /* remove a[l] */
-            tea_get_item(T, 0, u);
-            if(sort_comp(T, -1, -2)) /* a[u]<a[i]? */
-                set2(T, i, u);
-            else
-                tea_pop(T, 2);
+            int hi = lo + 2 * width < n ? lo + 2 * width : n;
+            merge(s, a, tmp, lo, lo + width, hi);
         }
-        if(u - l == 2)
-            break;            /* only 3 elements */
-        tea_get_item(T, 0, i); /* Pivot */
-        tea_push_value(T, -1);
-        tea_get_item(T, 0, u - 1);
-        set2(T, i, u - 1);
-        /* a[l] <= P == a[u-1] <= a[u], only need to sort from l+1 to u-2 */
-        i = l;
-        j = u - 1;
+    }
+}
+
+#define SORT_SIGN UINT64_C(0x8000000000000000)
+
+/* Maps a double to an integer with the same order, with -0 before 0 */
+static uint64_t number_key(double d)
+{
+    uint64_t u;
+    memcpy(&u, &d, sizeof(double));
+    return (u & SORT_SIGN) ? ~u : (u | SORT_SIGN);
+}
+
+static double key_number(uint64_t k)
+{
+    uint64_t u = (k & SORT_SIGN) ? (k & ~SORT_SIGN) : ~k;
+    double d;
+    memcpy(&d, &u, sizeof(double));
+    return d;
+}
+
+static void insertion_sort_keys(uint64_t* a, int lo, int hi)
+{
+    for(int i = lo + 1; i < hi; i++)
+    {
+        uint64_t v = a[i];
+        int j = i;
+        while(j > lo && v < a[j - 1])
+        {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
+    }
+}
+
+static void heap_sift(uint64_t* a, int root, int n)
+{
+    uint64_t v = a[root];
+    int child;
+    while((child = 2 * root + 1) < n)
+    {
+        child += (child + 1 < n) & (a[child] < a[child + 1]);
+        if(v >= a[child])
+            break;
+        a[root] = a[child];
+        root = child;
+    }
+    a[root] = v;
+}
+
+static void heap_sort_keys(uint64_t* a, int n)
+{
+    for(int i = n / 2 - 1; i >= 0; i--)
+        heap_sift(a, i, n);
+    for(int i = n - 1; i > 0; i--)
+    {
+        uint64_t t = a[0];
+        a[0] = a[i];
+        a[i] = t;
+        heap_sift(a, 0, i);
+    }
+}
+
+/* Introsort over [lo, hi) */
+static void intro_sort_keys(uint64_t* a, int lo, int hi, int depth)
+{
+    while(hi - lo > SORT_RUN)
+    {
+        if(depth-- == 0)
+        {
+            heap_sort_keys(a + lo, hi - lo);
+            return;
+        }
+
+        /* Median of three */
+        int mid = lo + (hi - lo) / 2;
+        uint64_t x = a[lo], y = a[mid], z = a[hi - 1];
+        uint64_t lo_v = x < y ? x : y, hi_v = x < y ? y : x;
+        uint64_t pivot = z < lo_v ? lo_v : (z < hi_v ? z : hi_v);
+
+        /* Hoare partition */
+        int i = lo - 1, j = hi;
         while(true)
-        { /* invariant: a[l..i] <= P <= a[j..u] */
-            /* repeat ++i until a[i] >= P */
-            while(tea_get_item(T, 0, ++i), sort_comp(T, -1, -2))
-            {
-                if(i > u)
-                    tea_error(T, "invalid order function for sorting");
-                tea_pop(T, 1); /* remove a[i] */
-            }
-            /* repeat --j until a[j] <= P */
-            while(tea_get_item(T, 0, --j), sort_comp(T, -3, -1))
-            {
-                if(j < l)
-                    tea_error(T, "invalid order function for sorting");
-                tea_pop(T, 1); /* remove a[j] */
-            }
-            if(j < i)
-            {
-                tea_pop(T, 3); /* pop pivot, a[i], a[j] */
+        {
+            do i++; while(a[i] < pivot);
+            do j--; while(pivot < a[j]);
+            if(i >= j)
                 break;
-            }
-            set2(T, i, j);
+            uint64_t t = a[i];
+            a[i] = a[j];
+            a[j] = t;
         }
-        tea_get_item(T, 0, u - 1);
-        tea_get_item(T, 0, i);
-        set2(T, u - 1, i); /* swap pivot (a[u-1]) with a[i] */
-        /* a[l..i-1] <= a[i] == P <= a[i+1..u] */
-        /* adjust so that smaller half is in [j..i] and larger one in [l..u] */
-        if(i - l < u - i)
+
+        /* Recurse into the smaller half */
+        if(j + 1 - lo < hi - j - 1)
         {
-            j = l;
-            i = i - 1;
-            l = i + 2;
+            intro_sort_keys(a, lo, j + 1, depth);
+            lo = j + 1;
         }
         else
         {
-            j = i + 1;
-            i = u;
-            u = j - 2;
+            intro_sort_keys(a, j + 1, hi, depth);
+            hi = j + 1;
+        }
+    }
+    insertion_sort_keys(a, lo, hi);
+}
+
+static int sort_depth(int n)
+{
+    int depth = 0;
+    for(int i = n; i > 1; i >>= 1)
+        depth += 2;
+    return depth;
+}
+
+typedef struct
+{
+    uint64_t* keys;         /* Number keys, NULL when sorting strings */
+    uint64_t* key_tmp;
+    TeaValue* values;
+    TeaValue* value_tmp;
+    int lo, mid, hi;
+} SortJob;
+
+/* Sorts [lo, hi) of a job */
+static void* sort_chunk(void* arg)
+{
+    SortJob* job = (SortJob*)arg;
+    if(job->keys != NULL)
+    {
+        intro_sort_keys(job->keys, job->lo, job->hi, sort_depth(job->hi - job->lo));
+    }
+    else
+    {
+        SortState s = { NULL, NULL, NULL };
+        merge_sort(&s, job->values + job->lo, job->value_tmp + job->lo, job->hi - job->lo);
+    }
+    return NULL;
+}
+
+/* Merges the sorted ranges [lo, mid) and [mid, hi) of a job */
+static void* merge_chunk(void* arg)
+{
+    SortJob* job = (SortJob*)arg;
+    int i = job->lo, j = job->mid, k = job->lo;
+
+    if(job->keys != NULL)
+    {
+        uint64_t* a = job->keys;
+        uint64_t* t = job->key_tmp;
+        while(i < job->mid && j < job->hi)
+            t[k++] = a[j] < a[i] ? a[j++] : a[i++];
+        while(i < job->mid)
+            t[k++] = a[i++];
+        while(j < job->hi)
+            t[k++] = a[j++];
+        memcpy(a + job->lo, t + job->lo, sizeof(uint64_t) * (job->hi - job->lo));
+    }
+    else
+    {
+        TeaValue* a = job->values;
+        TeaValue* t = job->value_tmp;
+        while(i < job->mid && j < job->hi)
+            t[k++] = value_less(a[j], a[i]) ? a[j++] : a[i++];
+        while(i < job->mid)
+            t[k++] = a[i++];
+        while(j < job->hi)
+            t[k++] = a[j++];
+        memcpy(a + job->lo, t + job->lo, sizeof(TeaValue) * (job->hi - job->lo));
+    }
+    return NULL;
+}
+
+#if defined(TEA_USE_PTHREADS)
+
+#define SORT_MAX_THREADS 64
+
+static int sort_threads(int n)
+{
+    int threads = TEA_SORT_THREADS;
+    if(threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    /* Keep every chunk above half the parallel threshold */
+    int limit = n / (TEA_SORT_PARALLEL_MIN / 2);
+    if(threads > limit)
+        threads = limit;
+    if(threads > SORT_MAX_THREADS)
+        threads = SORT_MAX_THREADS;
+    return threads;
+}
+
+/* Runs each job on its own thread, the last one on the calling thread */
+static void run_jobs(void* (*fn)(void*), SortJob* jobs, int n)
+{
+    pthread_t threads[SORT_MAX_THREADS];
+    bool started[SORT_MAX_THREADS];
+
+    for(int i = 0; i < n - 1; i++)
+    {
+        started[i] = pthread_create(&threads[i], NULL, fn, &jobs[i]) == 0;
+        if(!started[i])
+            fn(&jobs[i]);
+    }
+    fn(&jobs[n - 1]);
+
+    for(int i = 0; i < n - 1; i++)
+    {
+        if(started[i])
+            pthread_join(threads[i], NULL);
+    }
+}
+
+/* Sorts chunks on separate threads, then merges neighbouring chunks pairwise */
+static bool sort_parallel(SortJob* base, int n)
+{
+    int k = sort_threads(n);
+    if(k < 2)
+        return false;
+
+    int bounds[SORT_MAX_THREADS + 1];
+    SortJob jobs[SORT_MAX_THREADS];
+
+    for(int i = 0; i <= k; i++)
+        bounds[i] = (int)((int64_t)n * i / k);
+
+    for(int i = 0; i < k; i++)
+    {
+        jobs[i] = *base;
+        jobs[i].lo = bounds[i];
+        jobs[i].hi = bounds[i + 1];
+    }
+    run_jobs(sort_chunk, jobs, k);
+
+    while(k > 1)
+    {
+        int count = 0;
+        for(int i = 0; i + 1 < k; i += 2)
+        {
+            jobs[count] = *base;
+            jobs[count].lo = bounds[i];
+            jobs[count].mid = bounds[i + 1];
+            jobs[count].hi = bounds[i + 2];
+            count++;
         }
-        auxsort(T, j, i); /* call recursively the smaller one */
+        run_jobs(merge_chunk, jobs, count);
+
+        int m = 0;
+        for(int i = 0; i < k; i += 2)
+            bounds[m++] = bounds[i];
+        bounds[m] = bounds[k];
+        k = m;
     }
+
+    return true;
+}
+
+#else
+
+static bool sort_parallel(SortJob* base, int n)
+{
+    (void)base;
+    (void)n;
+    return false;
+}
+
+#endif
+
+static void sort_numbers(TeaState* T, TeaValue* values, int n)
+{
+    uint64_t* keys = TEA_ALLOCATE(T, uint64_t, n);
+
+    /* NaNs do not order, they go to the end */
+    int m = 0;
+    for(int i = 0; i < n; i++)
+    {
+        double d = AS_NUMBER(values[i]);
+        if(!isnan(d))
+            keys[m++] = number_key(d);
+    }
+
+    bool parallel = false;
+    if(m >= TEA_SORT_PARALLEL_MIN)
+    {
+        uint64_t* tmp = TEA_ALLOCATE(T, uint64_t, m);
+        SortJob job = { keys, tmp, NULL, NULL, 0, 0, m };
+        parallel = sort_parallel(&job, m);
+        TEA_FREE_ARRAY(T, uint64_t, tmp, m);
+    }
+    if(!parallel)
+        intro_sort_keys(keys, 0, m, sort_depth(m));
+
+    for(int i = 0; i < m; i++)
+        values[i] = NUMBER_VAL(key_number(keys[i]));
+    for(int i = m; i < n; i++)
+        values[i] = NUMBER_VAL(NAN);
+
+    TEA_FREE_ARRAY(T, uint64_t, keys, n);
+}
+
+static void sort_strings(TeaState* T, TeaValue* values, int n)
+{
+    TeaValue* tmp = TEA_ALLOCATE(T, TeaValue, n);
+
+    SortJob job = { NULL, NULL, values, tmp, 0, 0, n };
+    if(n < TEA_SORT_PARALLEL_MIN || !sort_parallel(&job, n))
+    {
+        SortState s = { T, NULL, NULL };
+        merge_sort(&s, values, tmp, n);
+    }
+
+    TEA_FREE_ARRAY(T, TeaValue, tmp, n);
+}
+
+/* A list on the stack keeps sort scratch space reachable while script functions run */
+static TeaValue* sort_buffer(TeaState* T, TeaValue* values, int n)
+{
+    TeaObjectList* buffer = tea_obj_new_list(T);
+    tea_vm_push(T, OBJECT_VAL(buffer));
+    TeaValue* a = TEA_ALLOCATE(T, TeaValue, n);
+    for(int i = 0; i < n; i++)
+        a[i] = values != NULL ? values[i] : NULL_VAL;
+
+    buffer->items.values = a;
+    buffer->items.capacity = n;
+    buffer->items.count = n;
+    return a;
+}
+
+/* Returns 1 if every value is a number, 2 if every value is a string, otherwise 0 */
+static int sort_kind(TeaValue* values, int n)
+{
+    int numbers = 0, strings = 0;
+    for(int i = 0; i < n; i++)
+    {
+        if(IS_NUMBER(values[i]))
+            numbers++;
+        else if(IS_STRING(values[i]))
+            strings++;
+    }
+    return numbers == n ? 1 : (strings == n ? 2 : 0);
+}
+
+static void sort_natural(TeaState* T, TeaValue* values, int n)
+{
+    switch(sort_kind(values, n))
+    {
+        case 1:
+            sort_numbers(T, values, n);
+            break;
+        case 2:
+            sort_strings(T, values, n);
+            break;
+        default:
+            tea_error(T, "Sort without a comparator expects all numbers or all strings");
+    }
+}
+
+static void sort_with_comparator(TeaState* T, TeaObjectList* list)
+{
+    int n = list->items.count;
+    TeaValue* a = sort_buffer(T, list->items.values, n);
+    TeaValue* tmp = sort_buffer(T, a, n);
+
+    TeaPreparedCall call;
+    tea_do_prepare_call(T, &call, T->base[1], 2);
+    SortState s = { T, NULL, &call };
+    merge_sort(&s, a, tmp, n);
+    tea_do_finish_call(T, &call);
+
+    if(list->items.count != n)
+        tea_error(T, "List modified during sort");
+    memcpy(list->items.values, a, sizeof(TeaValue) * n);
+    tea_pop(T, 2);
+}
+
+static void sort_with_key(TeaState* T, TeaObjectList* list)
+{
+    int n = list->items.count;
+    TeaValue* keys = sort_buffer(T, NULL, n);
+
+    /* The key function runs exactly once per element */
+    TeaPreparedCall call;
+    tea_do_prepare_call(T, &call, T->base[1], 1);
+    for(int i = 0; i < n; i++)
+    {
+        if(list->items.count != n)
+            tea_error(T, "List modified during sort");
+        tea_vm_push(T, call.func);
+        tea_vm_push(T, list->items.values[i]);
+        tea_do_prepared_call(T, &call);
+        keys[i] = tea_vm_pop(T, 1);
+    }
+    tea_do_finish_call(T, &call);
+    if(sort_kind(keys, n) == 0)
+        tea_error(T, "Sort keys must be all numbers or all strings");
+    if(list->items.count != n)
+        tea_error(T, "List modified during sort");
+
+    TeaValue* order = sort_buffer(T, NULL, n);
+    TeaValue* tmp = sort_buffer(T, NULL, n);
+    for(int i = 0; i < n; i++)
+        order[i] = NUMBER_VAL(i);
+
+    SortState s = { T, keys, NULL };
+    merge_sort(&s, order, tmp, n);
+
+    for(int i = 0; i < n; i++)
+        tmp[i] = list->items.values[(int)AS_NUMBER(order[i])];
+    memcpy(list->items.values, tmp, sizeof(TeaValue) * n);
+    tea_pop(T, 3);
+}
+
+static bool is_key_function(TeaValue f)
+{
+    if(!IS_CLOSURE(f))
+        return false;
+    TeaObjectFunction* function = AS_CLOSURE(f)->function;
+    return function->arity == 1 && !function->variadic;
 }
 
 static void list_sort(TeaState* T)
 {
     int count = tea_get_top(T);
-    tea_ensure_min_args(T, count, 1);
+    tea_ensure_max_args(T, count, 2);
 
-    int len = tea_len(T, 0);
-
-    if(!tea_is_nonenull(T, 1))
+    if(count == 2 && !tea_is_null(T, 1))
         tea_check_function(T, 1);
     tea_set_top(T, 2);
-    auxsort(T, 0, len - 1);
+
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    if(list->items.count > 1)
+    {
+        if(tea_is_null(T, 1))
+            sort_natural(T, list->items.values, list->items.count);
+        else if(is_key_function(T->base[1]))
+            sort_with_key(T, list);
+        else
+            sort_with_comparator(T, list);
+    }
+
     tea_pop(T, 1);
 }
 
@@ -469,15 +894,16 @@ static void list_copy(TeaState* T)
     int count = tea_get_top(T);
     tea_ensure_min_args(T, count, 1);
 
-    int len = tea_len(T, 0);
-
     tea_new_list(T);
+    tea_append_value_array(T, &AS_LIST(T->top[-1])->items, &AS_LIST(T->base[0])->items);
+}
 
-    for(int i = 0; i < len; i++) 
-    {
-        tea_get_item(T, 0, i);
-        tea_add_item(T, 1);
-    }
+/* Calls the prepared callback on item, leaving the result on the stack */
+static inline void call_item(TeaState* T, TeaPreparedCall* call, TeaValue item)
+{
+    tea_vm_push(T, call->func);
+    tea_vm_push(T, item);
+    tea_do_prepared_call(T, call);
 }
 
 static void list_find(TeaState* T) 
@@ -488,23 +914,26 @@ static void list_find(TeaState* T)
     tea_check_list(T, 0);
     tea_check_function(T, 1);
 
-    int len = tea_len(T, 0);
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    TeaPreparedCall call;
+    tea_do_prepare_call(T, &call, T->base[1], 1);
 
-    for(int i = 0; i < len; i++) 
+    for(int i = 0; i < list->items.count; i++) 
     {
-        tea_push_value(T, 1);
-        tea_get_item(T, 0, i);
-        tea_call(T, 1);
+        TeaValue item = list->items.values[i];
+        call_item(T, &call, item);
 
         bool found = tea_check_bool(T, -1);
         tea_pop(T, 1);
 
         if(found) 
         {
-            tea_get_item(T, 0, i);
+            tea_do_finish_call(T, &call);
+            tea_vm_push(T, item);
             return;
         }
     }
+    tea_do_finish_call(T, &call);
     tea_push_null(T);
 }
 
@@ -516,18 +945,21 @@ static void list_map(TeaState* T)
     tea_check_list(T, 0);
     tea_check_function(T, 1);
 
-    int len = tea_len(T, 0);
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    TeaObjectList* result = tea_obj_new_list(T);
+    tea_vm_push(T, OBJECT_VAL(result));
+    tea_reserve_value_array(T, &result->items, list->items.count);
 
-    tea_new_list(T);
+    TeaPreparedCall call;
+    tea_do_prepare_call(T, &call, T->base[1], 1);
 
-    for(int i = 0; i < len; i++) 
+    for(int i = 0; i < list->items.count; i++) 
     {
-        tea_push_value(T, 1);
-        tea_get_item(T, 0, i);
-        tea_call(T, 1);
-        tea_add_item(T, 2);
+        call_item(T, &call, list->items.values[i]);
+        tea_write_value_array(T, &result->items, T->top[-1]);
+        tea_pop(T, 1);
     }
-    tea_push_value(T, 2);
+    tea_do_finish_call(T, &call);
 }
 
 static void list_filter(TeaState* T) 
@@ -535,28 +967,29 @@ static void list_filter(TeaState* T)
     int count = tea_get_top(T);
     tea_ensure_min_args(T, count, 2);
 
-    int len = tea_len(T, 0);
+    tea_check_list(T, 0);
+    tea_check_function(T, 1);
 
-    tea_new_list(T);
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    TeaObjectList* result = tea_obj_new_list(T);
+    tea_vm_push(T, OBJECT_VAL(result));
 
-    int j = 0;
-    for(int i = 0; i < len; i++) 
-    {
-        tea_push_value(T, 1);
-        tea_get_item(T, 0, i);
-        tea_call(T, 1);
+    TeaPreparedCall call;
+    tea_do_prepare_call(T, &call, T->base[1], 1);
 
-        bool filter = tea_check_bool(T, -1);
-        tea_pop(T, 1);
+    for(int i = 0; i < list->items.count; i++) 
+    {
+        /* The callback may take the item out of the list, keep it on the stack */
+        tea_vm_push(T, list->items.values[i]);
+        call_item(T, &call, T->top[-1]);
 
-        if(filter) 
+        if(tea_check_bool(T, -1)) 
         {
-            tea_get_item(T, 0, i);
-            tea_add_item(T, 2);
-            j++;
+            tea_write_value_array(T, &result->items, T->top[-2]);
         }
+        tea_pop(T, 2);
     }
-    tea_push_value(T, 2);
+    tea_do_finish_call(T, &call);
 }
 
 static void list_reduce(TeaState* T) 
@@ -567,23 +1000,28 @@ static void list_reduce(TeaState* T)
     tea_check_list(T, 0);
     tea_check_function(T, 1);
 
-    int len = tea_len(T, 0);
-    if(len == 0)
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    if(list->items.count == 0)
     {
         tea_pop(T, 1);
         return;
     }
 
-    int i = 0;
-    tea_get_item(T, 0, i++);    /* pivot item */
-    for(; i < len; i++) 
+    TeaPreparedCall call;
+    tea_do_prepare_call(T, &call, T->base[1], 2);
+
+    tea_vm_push(T, list->items.values[0]);    /* pivot item */
+    for(int i = 1; i < list->items.count; i++) 
     {
-        tea_push_value(T, 1);
-        tea_push_value(T, -2);      /* push pivot */
-        tea_get_item(T, 0, i);
-        tea_call(T, 2);
-        tea_replace(T, -2);     /* replace pivot with newer item */
+        TeaValue pivot = T->top[-1];
+        tea_vm_push(T, call.func);
+        tea_vm_push(T, pivot);
+        tea_vm_push(T, list->items.values[i]);
+        tea_do_prepared_call(T, &call);
+        T->top[-2] = T->top[-1];    /* replace pivot with newer item */
+        tea_pop(T, 1);
     }
+    tea_do_finish_call(T, &call);
 }
 
 static void list_foreach(TeaState* T) 
@@ -594,15 +1032,16 @@ static void list_foreach(TeaState* T)
     tea_check_list(T, 0);
     tea_check_function(T, 1);
 
-    int len = tea_len(T, 0);
+    TeaObjectList* list = AS_LIST(T->base[0]);
+    TeaPreparedCall call;
+    tea_do_prepare_call(T, &call, T->base[1], 1);
 
-    for(int i = 0; i < len; i++) 
+    for(int i = 0; i < list->items.count; i++) 
     {
-        tea_push_value(T, 1);
-        tea_get_item(T, 0, i);
-        tea_call(T, 1);
+        call_item(T, &call, list->items.values[i]);
         tea_pop(T, 1);
     }
+    tea_do_finish_call(T, &call);
     tea_set_top(T, 1);
 }
 
@@ -654,6 +1093,8 @@ static void list_iteratorvalue(TeaState* T)
 
 static const TeaClass list_class[] = {
     { "len", "property", list_len },
+    { "constructor", "method", list_constructor },
+    { "reserve", "method", list_reserve },
     { "add", "method", list_add },
     { "remove", "method", list_remove },
     { "delete", "method", list_delete },
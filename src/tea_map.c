@@ -6,25 +6,9 @@
 #define tea_map_c
 #define TEA_CORE
 
-#include "tea_map.h"
+#include <string.h>
 
-TeaObjectMap* tea_map_new(TeaState* T)
-{
-    TeaObjectMap* map = ALLOCATE_OBJECT(T, TeaObjectMap, OBJ_MAP);
-    map->count = 0;
-    map->capacity = 0;
-    map->items = NULL;
-    
-    return map;
-}
-
-void tea_map_clear(TeaState* T, TeaObjectMap* map)
-{
-    TEA_FREE_ARRAY(T, TeaMapItem, map->items, map->capacity);
-    map->items = NULL;
-    map->capacity = 0;
-    map->count = 0;
-}
+#include "tea_map.h"
 
 static inline uint32_t hash_bits(uint64_t hash)
 {
@@ -57,11 +41,13 @@ static uint32_t hash_object(TeaObject* object)
         case OBJ_STRING:
             return ((TeaObjectString*)object)->hash;
 
-        default: return 0;
+        default:
+            /* Objects never move, so the address is a stable identity hash */
+            return hash_bits((uint64_t)(uintptr_t)object);
     }
 }
 
-static uint32_t hash_value(TeaValue value)
+uint32_t tea_map_hash(TeaValue value)
 {
 #ifdef TEA_NAN_TAGGING
     if(IS_OBJECT(value)) return hash_object(AS_OBJECT(value));
@@ -81,41 +67,138 @@ static uint32_t hash_value(TeaValue value)
 #endif
 }
 
-static TeaMapItem* map_find_entry(TeaMapItem* items, int capacity, TeaValue key)
+static inline bool key_equal(TeaValue a, TeaValue b)
 {
-    uint32_t hash = hash_value(key);
-    uint32_t index = hash & (capacity - 1);
-    TeaMapItem* tombstone = NULL;
+#ifdef TEA_NAN_TAGGING
+    return a == b;
+#else
+    return tea_value_equal(a, b);
+#endif
+}
+
+/* Offsets need one more bit than the largest item position */
+static inline int index_width(int index_size)
+{
+    if(index_size <= 128)
+        return 1;
+    if(index_size <= 32768)
+        return 2;
+    return 4;
+}
+
+static inline int index_get(void* index, int index_size, uint32_t slot)
+{
+    switch(index_width(index_size))
+    {
+        case 1: return ((int8_t*)index)[slot];
+        case 2: return ((int16_t*)index)[slot];
+        default: return ((int32_t*)index)[slot];
+    }
+}
+
+void tea_map_index_set(void* index, int index_size, uint32_t slot, int offset)
+{
+    switch(index_width(index_size))
+    {
+        case 1: ((int8_t*)index)[slot] = (int8_t)offset; break;
+        case 2: ((int16_t*)index)[slot] = (int16_t)offset; break;
+        default: ((int32_t*)index)[slot] = (int32_t)offset; break;
+    }
+}
+
+/*
+** Returns the offset of key or -1, and sets slot to where the key is
+** or where it should be inserted
+*/
+int tea_map_index_lookup(void* index, int index_size, const TeaValue* keys, int stride, TeaValue key, uint32_t hash, uint32_t* slot)
+{
+    uint32_t mask = index_size - 1;
+    uint32_t i = hash & mask;
+    int64_t deleted = -1;
 
     while(true)
     {
-        TeaMapItem* item = &items[index];
-        if(item->empty)
+        int offset = index_get(index, index_size, i);
+        if(offset == MAP_INDEX_EMPTY)
         {
-            if(IS_NULL(item->value))
-            {
-                /* Empty item */
-                return tombstone != NULL ? tombstone : item;
-            }
-            else
-            {
-                /* We found a tombstone */
-                if(tombstone == NULL)
-                    tombstone = item;
-            }
+            *slot = deleted >= 0 ? (uint32_t)deleted : i;
+            return -1;
         }
-#ifdef TEA_NAN_TAGGING
-        else if(item->key == key)
-#else
-        else if(tea_value_equal(item->key, key))
-#endif
+        if(offset == MAP_INDEX_DELETED)
         {
-            /* We found the key */
-            return item;
+            if(deleted < 0)
+                deleted = i;
         }
+        else if(key_equal(keys[offset * stride], key))
+        {
+            *slot = i;
+            return offset;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+/* Smallest index that keeps count items at most two thirds full with room to grow */
+int tea_map_index_size(int count)
+{
+    int index_size = MAP_MIN_INDEX;
+    while(index_size * 2 / 3 < count * 3 / 2 + 1)
+        index_size *= 2;
+    return index_size;
+}
+
+void* tea_map_index_build(TeaState* T, int index_size, const TeaValue* keys, int stride, int used)
+{
+    int width = index_width(index_size);
+    void* index = TEA_ALLOCATE(T, uint8_t, index_size * width);
+    memset(index, 0xff, index_size * width);   /* MAP_INDEX_EMPTY */
 
-        index = (index + 1) & (capacity - 1);
+    uint32_t mask = index_size - 1;
+    for(int i = 0; i < used; i++)
+    {
+        uint32_t slot = tea_map_hash(keys[i * stride]) & mask;
+        while(index_get(index, index_size, slot) != MAP_INDEX_EMPTY)
+            slot = (slot + 1) & mask;
+        tea_map_index_set(index, index_size, slot, i);
     }
+
+    return index;
+}
+
+void tea_map_index_free(TeaState* T, void* index, int index_size)
+{
+    TEA_FREE_ARRAY(T, uint8_t, index, index_size * index_width(index_size));
+}
+
+TeaObjectMap* tea_map_new(TeaState* T)
+{
+    TeaObjectMap* map = ALLOCATE_OBJECT(T, TeaObjectMap, OBJ_MAP);
+    map->count = 0;
+    map->used = 0;
+    map->capacity = 0;
+    map->index_size = 0;
+    map->index = NULL;
+    map->items = NULL;
+    
+    return map;
+}
+
+void tea_map_clear(TeaState* T, TeaObjectMap* map)
+{
+    TEA_FREE_ARRAY(T, TeaMapItem, map->items, map->capacity);
+    tea_map_index_free(T, map->index, map->index_size);
+    map->items = NULL;
+    map->index = NULL;
+    map->index_size = 0;
+    map->capacity = 0;
+    map->used = 0;
+    map->count = 0;
+}
+
+static inline int map_lookup(TeaObjectMap* map, TeaValue key, uint32_t hash, uint32_t* slot)
+{
+    return tea_map_index_lookup(map->index, map->index_size, &map->items->key, 2, key, hash, slot);
 }
 
 bool tea_map_get(TeaObjectMap* map, TeaValue key, TeaValue* value)
@@ -123,65 +206,73 @@ bool tea_map_get(TeaObjectMap* map, TeaValue key, TeaValue* value)
     if(map->count == 0)
         return false;
 
-    TeaMapItem* item = map_find_entry(map->items, map->capacity, key);
-    if(item->empty)
+    uint32_t slot;
+    int offset = map_lookup(map, key, tea_map_hash(key), &slot);
+    if(offset < 0)
         return false;
 
-    *value = item->value;
+    *value = map->items[offset].value;
 
     return true;
 }
 
-#define MAP_MAX_LOAD 0.75
-
-static void map_adjust_size(TeaState* T, TeaObjectMap* map, int capacity)
+/* Compacts the live items in order into a table sized for count of them */
+static void map_resize(TeaState* T, TeaObjectMap* map, int count)
 {
+    int index_size = tea_map_index_size(count);
+    int capacity = index_size * 2 / 3;
+
     TeaMapItem* items = TEA_ALLOCATE(T, TeaMapItem, capacity);
-    for(int i = 0; i < capacity; i++)
-    {
-        items[i].key = NULL_VAL;
-        items[i].value = NULL_VAL;
-        items[i].empty = true;
-    }
 
-    map->count = 0;
-    for(int i = 0; i < map->capacity; i++)
+    int used = 0;
+    for(int i = 0; i < map->used; i++)
     {
         TeaMapItem* item = &map->items[i];
-        if(item->empty)
+        if(MAP_ITEM_EMPTY(item))
             continue;
-
-        TeaMapItem* dest = map_find_entry(items, capacity, item->key);
-        dest->key = item->key;
-        dest->value = item->value;
-        dest->empty = false;
-        map->count++;
+        items[used++] = *item;
     }
 
+    void* index = tea_map_index_build(T, index_size, &items->key, 2, used);
+
     TEA_FREE_ARRAY(T, TeaMapItem, map->items, map->capacity);
+    tea_map_index_free(T, map->index, map->index_size);
     map->items = items;
+    map->index = index;
+    map->index_size = index_size;
     map->capacity = capacity;
+    map->used = used;
 }
 
 bool tea_map_set(TeaState* T, TeaObjectMap* map, TeaValue key, TeaValue value)
 {
-    if(map->count + 1 > map->capacity * MAP_MAX_LOAD)
+    uint32_t hash = tea_map_hash(key);
+    uint32_t slot;
+
+    if(map->count > 0)
     {
-        int capacity = TEA_GROW_CAPACITY(map->capacity);
-        map_adjust_size(T, map, capacity);
+        int offset = map_lookup(map, key, hash, &slot);
+        if(offset >= 0)
+        {
+            map->items[offset].value = value;
+            return false;
+        }
     }
 
-    TeaMapItem* item = map_find_entry(map->items, map->capacity, key);
-    bool is_new_key = item->empty;
-
-    if(is_new_key && IS_NULL(item->value))
-        map->count++;
+    if(map->used == map->capacity)
+    {
+        map_resize(T, map, map->count + 1);
+    }
+    map_lookup(map, key, hash, &slot);
 
+    TeaMapItem* item = &map->items[map->used];
     item->key = key;
     item->value = value;
-    item->empty = false;
+    tea_map_index_set(map->index, map->index_size, slot, map->used);
+    map->used++;
+    map->count++;
     
-    return is_new_key;
+    return true;
 }
 
 bool tea_map_delete(TeaState* T, TeaObjectMap* map, TeaValue key)
@@ -190,40 +281,33 @@ bool tea_map_delete(TeaState* T, TeaObjectMap* map, TeaValue key)
         return false;
 
     /* Find the entry */
-    TeaMapItem* item = map_find_entry(map->items, map->capacity, key);
-    if(item->empty)
+    uint32_t slot;
+    int offset = map_lookup(map, key, tea_map_hash(key), &slot);
+    if(offset < 0)
         return false;
 
-    /* Place a tombstone in the entry */
-    item->key = NULL_VAL;
-    item->value = TRUE_VAL;
-    item->empty = true;
-
+    /* The item keeps its place until the next resize compacts it away */
+    tea_map_index_set(map->index, map->index_size, slot, MAP_INDEX_DELETED);
+    map->items[offset].key = MAP_EMPTY_KEY;
+    map->items[offset].value = NULL_VAL;
     map->count--;
 
     if(map->count == 0)
     {
         tea_map_clear(T, map);
     }
-    else if(map->count - 1 < map->capacity * MAP_MAX_LOAD)
-    {
-        uint32_t capacity = map->capacity / 2;
-        if(capacity < 16) capacity = 16;
-
-        map_adjust_size(T, map, capacity);
-    }
 
     return true;
 }
 
 void tea_map_add_all(TeaState* T, TeaObjectMap* from, TeaObjectMap* to)
 {
-    for(int i = 0; i < from->capacity; i++)
+    for(int i = 0; i < from->used; i++)
     {
         TeaMapItem* item = &from->items[i];
-        if(!item->empty)
+        if(!MAP_ITEM_EMPTY(item))
         {
             tea_map_set(T, to, item->key, item->value);
         }
     }
-}
\ No newline at end of file
+}
@@ -8,6 +8,20 @@
 
 #include "tea_object.h"
 
+/* Index slot markers, everything else is an offset into the items */
+#define MAP_INDEX_EMPTY (-1)
+#define MAP_INDEX_DELETED (-2)
+
+#define MAP_MIN_INDEX 8
+
+/* The ordered index is shared with sets, keys are read every stride values */
+uint32_t tea_map_hash(TeaValue value);
+int tea_map_index_size(int count);
+int tea_map_index_lookup(void* index, int index_size, const TeaValue* keys, int stride, TeaValue key, uint32_t hash, uint32_t* slot);
+void tea_map_index_set(void* index, int index_size, uint32_t slot, int offset);
+void* tea_map_index_build(TeaState* T, int index_size, const TeaValue* keys, int stride, int used);
+void tea_map_index_free(TeaState* T, void* index, int index_size);
+
 TeaObjectMap* tea_map_new(TeaState* T);
 
 void tea_map_clear(TeaState* T, TeaObjectMap* map);
@@ -16,10 +30,4 @@ bool tea_map_get(TeaObjectMap* map, TeaValue key, TeaValue* value);
 bool tea_map_delete(TeaState* T, TeaObjectMap* map, TeaValue key);
 void tea_map_add_all(TeaState* T, TeaObjectMap* from, TeaObjectMap* to);
 
-static inline bool tea_map_validkey(TeaValue value)
-{
-    return IS_NULL(value) || IS_BOOL(value) || IS_NUMBER(value) ||
-    IS_STRING(value);
-}
-
 #endif
\ No newline at end of file
@@ -22,9 +22,10 @@ static void map_keys(TeaState* T)
     tea_new_list(T);
 
     TeaObjectList* list = AS_LIST(T->base[1]);
-    for(int i = 0; i < map->capacity; i++)
+    tea_reserve_value_array(T, &list->items, map->count);
+    for(int i = 0; i < map->used; i++)
     {
-        if(map->items[i].empty) continue;
+        if(MAP_ITEM_EMPTY(&map->items[i])) continue;
         tea_write_value_array(T, &list->items, map->items[i].key);
     }
 }
@@ -36,9 +37,10 @@ static void map_values(TeaState* T)
     tea_new_list(T);
 
     TeaObjectList* list = AS_LIST(T->base[1]);
-    for(int i = 0; i < map->capacity; i++)
+    tea_reserve_value_array(T, &list->items, map->count);
+    for(int i = 0; i < map->used; i++)
     {
-        if(map->items[i].empty) continue;
+        if(MAP_ITEM_EMPTY(&map->items[i])) continue;
         tea_write_value_array(T, &list->items, map->items[i].value);
     }
 }
@@ -59,11 +61,6 @@ static void map_contains(TeaState* T)
 
     TeaObjectMap* map = AS_MAP(T->base[0]);
 
-    if(!tea_map_validkey(T->base[1]))
-    {
-        tea_error(T, "Map key isn't hashable");
-    }
-    
     TeaValue _;
     tea_push_bool(T, tea_map_get(map, T->base[1], &_));
 }
@@ -75,11 +72,7 @@ static void map_delete(TeaState* T)
 
     TeaObjectMap* map = AS_MAP(T->base[0]);
     TeaValue _;
-    if(!tea_map_validkey(T->base[1]))
-    {
-        tea_error(T, "Map key isn't hashable");
-    }
-    else if(!tea_map_get(map, T->base[1], &_))
+    if(!tea_map_get(map, T->base[1], &_))
     {
         tea_error(T, "No such key in the map");
     }
@@ -97,9 +90,9 @@ static void map_copy(TeaState* T)
     tea_new_map(T);
 
     TeaObjectMap* new = AS_MAP(T->base[1]);
-    for(int i = 0; i < map->capacity; i++)
+    for(int i = 0; i < map->used; i++)
     {
-        if(map->items[i].empty) continue;
+        if(MAP_ITEM_EMPTY(&map->items[i])) continue;
         tea_map_set(T, new, map->items[i].key, map->items[i].value);
     }
 }
@@ -134,7 +127,7 @@ static void map_iterate(TeaState* T)
             return;
         }
 
-        if(index >= map->capacity)
+        if(index >= map->used)
         {
             tea_push_null(T);
             return;
@@ -145,9 +138,9 @@ static void map_iterate(TeaState* T)
     }
 
     /* Find a used entry, if any */
-    for(; index < map->capacity; index++)
+    for(; index < map->used; index++)
     {
-        if (!map->items[index].empty)
+        if(!MAP_ITEM_EMPTY(&map->items[index]))
         {
             tea_push_number(T, index);
             return;
@@ -166,8 +159,13 @@ static void map_iteratorvalue(TeaState* T)
     TeaObjectMap* map = AS_MAP(T->base[0]);
     int index = tea_check_number(T, 1);
 
+    if(index < 0 || index >= map->used)
+    {
+        tea_error(T, "Invalid map iterator");
+    }
+
     TeaMapItem* item = &map->items[index];
-    if(item->empty)
+    if(MAP_ITEM_EMPTY(item))
     {
         tea_error(T, "Invalid map iterator");
     }
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 #define tea_object_c
 #define TEA_CORE
@@ -13,6 +14,7 @@
 #include "tea_memory.h"
 #include "tea_object.h"
 #include "tea_map.h"
+#include "tea_set.h"
 #include "tea_string.h"
 #include "tea_table.h"
 #include "tea_value.h"
@@ -117,6 +119,14 @@ TeaObjectFile* tea_obj_new_file(TeaState* T, TeaObjectString* path, TeaObjectStr
     file->path = path;
     file->type = type;
     file->is_open = true;
+    file->buffer = NULL;
+    file->regular = false;
+    file->buffer_size = 0;
+    file->buffer_start = 0;
+    file->buffer_end = 0;
+    file->map = NULL;
+    file->map_size = 0;
+    file->map_pos = 0;
 
     return file;
 }
@@ -131,6 +141,92 @@ TeaObjectRange* tea_obj_new_range(TeaState* T, double start, double end, double
     return range;
 }
 
+TeaObjectIterator* tea_obj_new_iterator(TeaState* T, TeaIteratorKind kind, TeaValue source)
+{
+    TeaObjectIterator* iterator = ALLOCATE_OBJECT(T, TeaObjectIterator, OBJ_ITERATOR);
+    iterator->kind = kind;
+    iterator->done = false;
+    iterator->source = source;
+    iterator->fn = NULL_VAL;
+    iterator->state = NULL_VAL;
+    iterator->count = 0;
+    iterator->n = 0;
+    iterator->value = NULL_VAL;
+
+    return iterator;
+}
+
+TeaObjectBuffer* tea_obj_new_buffer(TeaState* T, int length)
+{
+    /* Keep some storage even when empty, so bytes is never NULL */
+    int capacity = length < 8 ? 8 : length;
+    uint8_t* bytes = TEA_ALLOCATE(T, uint8_t, capacity);
+    memset(bytes, 0, length);
+
+    TeaObjectBuffer* buffer = ALLOCATE_OBJECT(T, TeaObjectBuffer, OBJ_BUFFER);
+    buffer->owner = NULL;
+    buffer->bytes = bytes;
+    buffer->offset = 0;
+    buffer->length = length;
+    buffer->capacity = capacity;
+
+    return buffer;
+}
+
+TeaObjectBuffer* tea_obj_new_buffer_view(TeaState* T, TeaObjectBuffer* buffer, int offset, int length)
+{
+    /* Views of views look straight into the owner */
+    if(buffer->owner != NULL)
+    {
+        offset += buffer->offset;
+        buffer = buffer->owner;
+    }
+
+    TeaObjectBuffer* view = ALLOCATE_OBJECT(T, TeaObjectBuffer, OBJ_BUFFER);
+    view->owner = buffer;
+    view->bytes = NULL;
+    view->offset = offset;
+    view->length = length;
+    view->capacity = 0;
+
+    return view;
+}
+
+/* Resizes an owning buffer, new bytes are zeroed */
+void tea_obj_buffer_resize(TeaState* T, TeaObjectBuffer* buffer, int length)
+{
+    if(length > buffer->capacity)
+    {
+        int capacity = buffer->capacity;
+        while(capacity < length)
+        {
+            capacity = capacity > INT_MAX / 2 ? INT_MAX : capacity * 2;
+        }
+        buffer->bytes = TEA_GROW_ARRAY(T, uint8_t, buffer->bytes, buffer->capacity, capacity);
+        buffer->capacity = capacity;
+    }
+
+    if(length > buffer->length)
+    {
+        memset(buffer->bytes + buffer->length, 0, length - buffer->length);
+    }
+    buffer->length = length;
+}
+
+/* Start of the bytes of a buffer, views are looked up through their owner */
+uint8_t* tea_obj_buffer_bytes(TeaState* T, TeaObjectBuffer* buffer)
+{
+    TeaObjectBuffer* owner = buffer->owner;
+    if(owner == NULL)
+        return buffer->bytes;
+
+    if(buffer->offset + buffer->length > owner->length)
+    {
+        tea_vm_error(T, "Buffer view is outside its resized buffer");
+    }
+    return owner->bytes + buffer->offset;
+}
+
 static TeaObjectString* function_tostring(TeaState* T, TeaObjectFunction* function)
 {
     if(function->name == NULL)
@@ -219,10 +315,10 @@ static TeaObjectString* map_tostring(TeaState* T, TeaObjectMap* map)
     memcpy(string, "{", 1);
     int length = 1;
 
-    for(int i = 0; i < map->capacity; i++) 
+    for(int i = 0; i < map->used; i++) 
     {
         TeaMapItem* item = &map->items[i];
-        if(item->empty) 
+        if(MAP_ITEM_EMPTY(item)) 
         {
             continue;
         }
@@ -330,6 +426,66 @@ static TeaObjectString* map_tostring(TeaState* T, TeaObjectMap* map)
     return tea_string_take(T, string, length);
 }
 
+static TeaObjectString* set_tostring(TeaState* T, TeaObjectSet* set)
+{
+    if(set->count == 0)
+        return tea_string_literal(T, "set()");
+
+    int count = 0;
+    int size = 50;
+
+    char* string = TEA_ALLOCATE(T, char, size);
+    memcpy(string, "{", 1);
+    int length = 1;
+
+    for(int i = 0; i < set->used; i++) 
+    {
+        TeaValue value = set->items[i];
+        if(SET_ITEM_EMPTY(value))
+        {
+            continue;
+        }
+
+        count++;
+
+        TeaObjectString* s = tea_value_tostring(T, value);
+        char* element = s->chars;
+        int element_size = s->length;
+
+        if(element_size > (size - length - 6)) 
+        {
+            int old_size = size;
+            if(element_size > size) 
+            {
+                size = size + element_size * 2 + 6;
+            } 
+            else
+            {
+                size = size * 2 + 6;
+            }
+
+            string = TEA_GROW_ARRAY(T, char, string, old_size, size);
+        }
+
+        memcpy(string + length, element, element_size);
+        length += element_size;
+
+        if(count != set->count) 
+        {
+            memcpy(string + length, ", ", 2);
+            length += 2;
+        }
+    }
+
+    memcpy(string + length, "}", 1);
+    length += 1;
+    string[length] = '\0';
+
+    string = TEA_GROW_ARRAY(T, char, string, size, length + 1);
+
+    return tea_string_take(T, string, length);
+}
+
 static TeaObjectString* range_tostring(TeaState* T, TeaObjectRange* range)
 {
     char* start = tea_value_number_tostring(T, range->start)->chars;
@@ -396,8 +552,14 @@ TeaObjectString* tea_obj_tostring(TeaState* T, TeaValue value)
             return list_tostring(T, AS_LIST(value));
         case OBJ_MAP:
             return map_tostring(T, AS_MAP(value));
+        case OBJ_SET:
+            return set_tostring(T, AS_SET(value));
         case OBJ_RANGE:
             return range_tostring(T, AS_RANGE(value));
+        case OBJ_ITERATOR:
+            return tea_string_literal(T, "<iterator>");
+        case OBJ_BUFFER:
+            return tea_string_literal(T, "<buffer>");
         case OBJ_MODULE:
             return module_tostring(T, AS_MODULE(value));
         case OBJ_CLASS:
@@ -449,11 +611,11 @@ static bool map_equals(TeaObjectMap* a, TeaObjectMap* b)
         return true;
     }
 
-    for(int i = 0; i < a->capacity; i++)
+    for(int i = 0; i < a->used; i++)
     {
         TeaMapItem* item = &a->items[i];
 
-        if(item->empty)
+        if(MAP_ITEM_EMPTY(item))
         {
             continue;
         }
@@ -473,6 +635,43 @@ static bool map_equals(TeaObjectMap* a, TeaObjectMap* b)
     return true;
 }
 
+static bool set_equals(TeaObjectSet* a, TeaObjectSet* b)
+{
+    if(a->count != b->count)
+    {
+        return false;
+    }
+
+    for(int i = 0; i < a->used; i++)
+    {
+        if(!SET_ITEM_EMPTY(a->items[i]) && !tea_set_contains(b, a->items[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool buffer_equals(TeaObjectBuffer* a, TeaObjectBuffer* b)
+{
+    if(a->length != b->length)
+    {
+        return false;
+    }
+
+    /* A view left outside its resized owner equals nothing */
+    const uint8_t* x = a->owner == NULL ? a->bytes : a->owner->bytes + a->offset;
+    const uint8_t* y = b->owner == NULL ? b->bytes : b->owner->bytes + b->offset;
+    if((a->owner != NULL && a->offset + a->length > a->owner->length) ||
+       (b->owner != NULL && b->offset + b->length > b->owner->length))
+    {
+        return false;
+    }
+
+    return memcmp(x, y, a->length) == 0;
+}
+
 bool tea_obj_equal(TeaValue a, TeaValue b)
 {
     if(OBJECT_TYPE(a) != OBJECT_TYPE(b)) return false;
@@ -485,6 +684,10 @@ bool tea_obj_equal(TeaValue a, TeaValue b)
             return list_equals(AS_LIST(a), AS_LIST(b));
         case OBJ_MAP:
             return map_equals(AS_MAP(a), AS_MAP(b));
+        case OBJ_SET:
+            return set_equals(AS_SET(a), AS_SET(b));
+        case OBJ_BUFFER:
+            return buffer_equals(AS_BUFFER(a), AS_BUFFER(b));
         default:
             break;
     }
@@ -503,6 +706,10 @@ const char* tea_obj_type(TeaValue a)
             return "file";
         case OBJ_RANGE:
             return "range";
+        case OBJ_ITERATOR:
+            return "iterator";
+        case OBJ_BUFFER:
+            return "buffer";
         case OBJ_MODULE:
             return "module";
         case OBJ_CLASS:
@@ -517,6 +724,8 @@ const char* tea_obj_type(TeaValue a)
             return "list";
         case OBJ_MAP:
             return "map";
+        case OBJ_SET:
+            return "set";
         case OBJ_NATIVE:
         {
             switch(AS_NATIVE(a)->type)
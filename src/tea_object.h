@@ -24,6 +24,9 @@
 #define IS_MODULE(value) tea_obj_istype(value, OBJ_MODULE)
 #define IS_LIST(value) tea_obj_istype(value, OBJ_LIST)
 #define IS_MAP(value) tea_obj_istype(value, OBJ_MAP)
+#define IS_SET(value) tea_obj_istype(value, OBJ_SET)
+#define IS_ITERATOR(value) tea_obj_istype(value, OBJ_ITERATOR)
+#define IS_BUFFER(value) tea_obj_istype(value, OBJ_BUFFER)
 #define IS_BOUND_METHOD(value) tea_obj_istype(value, OBJ_BOUND_METHOD)
 #define IS_CLASS(value) tea_obj_istype(value, OBJ_CLASS)
 #define IS_CLOSURE(value) tea_obj_istype(value, OBJ_CLOSURE)
@@ -38,6 +41,9 @@
 #define AS_MODULE(value) ((TeaObjectModule*)AS_OBJECT(value))
 #define AS_LIST(value) ((TeaObjectList*)AS_OBJECT(value))
 #define AS_MAP(value) ((TeaObjectMap*)AS_OBJECT(value))
+#define AS_SET(value) ((TeaObjectSet*)AS_OBJECT(value))
+#define AS_ITERATOR(value) ((TeaObjectIterator*)AS_OBJECT(value))
+#define AS_BUFFER(value) ((TeaObjectBuffer*)AS_OBJECT(value))
 #define AS_BOUND_METHOD(value) ((TeaObjectBoundMethod*)AS_OBJECT(value))
 #define AS_CLASS(value) ((TeaObjectClass*)AS_OBJECT(value))
 #define AS_CLOSURE(value) ((TeaObjectClosure*)AS_OBJECT(value))
@@ -63,6 +69,9 @@ typedef enum
     OBJ_BOUND_METHOD,
     OBJ_LIST,
     OBJ_MAP,
+    OBJ_SET,
+    OBJ_ITERATOR,
+    OBJ_BUFFER,
     OBJ_FILE,
 } TeaObjectType;
 
@@ -90,6 +99,43 @@ typedef struct
     double step;
 } TeaObjectRange;
 
+typedef enum
+{
+    ITER_SOURCE,
+    ITER_MAP,
+    ITER_FILTER,
+    ITER_TAKE,
+    ITER_SKIP,
+    ITER_ZIP,
+    ITER_ENUMERATE,
+    ITER_CHUNK
+} TeaIteratorKind;
+
+/* One stage of a lazy pipeline, pulling items from source one at a time */
+typedef struct
+{
+    TeaObject obj;
+    TeaIteratorKind kind;
+    bool done;
+    TeaValue source;    /* The sequence of a source stage, otherwise the upstream iterator */
+    TeaValue fn;        /* Function of map and filter, the other iterator of zip */
+    TeaValue state;     /* Iteration state of a source sequence */
+    double count;       /* Items produced so far */
+    double n;           /* Limit of take and skip, size of chunk */
+    TeaValue value;     /* Item produced last */
+} TeaObjectIterator;
+
+/* Mutable bytes, or a fixed window onto the bytes of another buffer */
+typedef struct TeaObjectBuffer
+{
+    TeaObject obj;
+    struct TeaObjectBuffer* owner;  /* Buffer a view looks into, NULL when it owns its bytes */
+    uint8_t* bytes;     /* Storage of an owning buffer */
+    int offset;         /* Start of a view within its owner */
+    int length;
+    int capacity;
+} TeaObjectBuffer;
+
 struct TeaObjectFile
 {
     TeaObject obj;
@@ -97,6 +143,14 @@ struct TeaObjectFile
     TeaObjectString* path;
     TeaObjectString* type;
     int is_open;
+    char* buffer;       /* Read ahead for line reading, allocated on first use */
+    bool regular;       /* Regular files refill the buffer in bulk */
+    int buffer_size;
+    int buffer_start;
+    int buffer_end;
+    char* map;          /* Contents when opened with "m", NULL otherwise */
+    size_t map_size;
+    size_t map_pos;
 };
 
 typedef struct
@@ -141,6 +195,10 @@ struct TeaObjectString
     int length;
     char* chars;
     uint32_t hash;
+    bool ascii;
+    int utf_length;         /* Codepoint count, -1 until first needed */
+    uint32_t* utf_index;    /* Byte offset of every TEA_UTF_INDEX_STRIDE'th codepoint */
+    struct TeaFormat* format;   /* Parsed spec when used as a format string */
 };
 
 typedef struct
@@ -160,17 +218,36 @@ typedef struct
 {
     TeaValue key;
     TeaValue value;
-    bool empty;
 } TeaMapItem;
 
+/* Deleted items keep their place until the map is compacted */
+#define MAP_EMPTY_KEY OBJECT_VAL(NULL)
+#define MAP_ITEM_EMPTY(item) (IS_OBJECT((item)->key) && AS_OBJECT((item)->key) == NULL)
+#define SET_ITEM_EMPTY(value) (IS_OBJECT(value) && AS_OBJECT(value) == NULL)
+
 typedef struct
 {
     TeaObject obj;
-    int count;
+    int count;          /* Live items */
+    int used;           /* Items appended so far, including deleted ones */
     int capacity;
-    TeaMapItem* items;
+    int index_size;     /* Slots in index, a power of two */
+    void* index;        /* int8_t, int16_t or int32_t offsets into items */
+    TeaMapItem* items;  /* In insertion order */
 } TeaObjectMap;
 
+/* Same layout as a map, without the values */
+typedef struct
+{
+    TeaObject obj;
+    int count;
+    int used;
+    int capacity;
+    int index_size;
+    void* index;
+    TeaValue* items;
+} TeaObjectSet;
+
 typedef struct TeaObjectUpvalue
 {
     TeaObject obj;
@@ -225,6 +302,13 @@ TeaObjectModule* tea_obj_new_module(TeaState* T, TeaObjectString* name);
 TeaObjectFile* tea_obj_new_file(TeaState* T, TeaObjectString* path, TeaObjectString* type);
 TeaObjectRange* tea_obj_new_range(TeaState* T, double start, double end, double step);
 
+TeaObjectIterator* tea_obj_new_iterator(TeaState* T, TeaIteratorKind kind, TeaValue source);
+
+TeaObjectBuffer* tea_obj_new_buffer(TeaState* T, int length);
+TeaObjectBuffer* tea_obj_new_buffer_view(TeaState* T, TeaObjectBuffer* buffer, int offset, int length);
+void tea_obj_buffer_resize(TeaState* T, TeaObjectBuffer* buffer, int length);
+uint8_t* tea_obj_buffer_bytes(TeaState* T, TeaObjectBuffer* buffer);
+
 TeaObjectString* tea_obj_tostring(TeaState* T, TeaValue value);
 bool tea_obj_equal(TeaValue a, TeaValue b);
 const char* tea_obj_type(TeaValue a);
@@ -241,7 +325,8 @@ static inline bool tea_obj_isfalse(TeaValue value)
             (IS_NUMBER(value) && AS_NUMBER(value) == 0) || 
             (IS_STRING(value) && AS_CSTRING(value)[0] == '\0') || 
             (IS_LIST(value) && AS_LIST(value)->items.count == 0) ||
-            (IS_MAP(value) && AS_MAP(value)->count == 0);
+            (IS_MAP(value) && AS_MAP(value)->count == 0) ||
+            (IS_SET(value) && AS_SET(value)->count == 0);
 }
 
 #endif
\ No newline at end of file
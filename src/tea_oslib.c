@@ -15,6 +15,20 @@
 
 #include "tea_import.h"
 #include "tea_core.h"
+#include "tea_state.h"
+#include "tea_string.h"
+#include "tea_memory.h"
+#include "tea_map.h"
+#include "tea_vm.h"
+
+#if defined(TEA_USE_POSIX)
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#endif
 
 #ifdef _WIN32
 #define unsetenv(NAME) _putenv_s(NAME, "")
@@ -100,10 +114,276 @@ static void os_system(TeaState* T)
     tea_ensure_min_args(T, count, 1);
 
     const char* arg = tea_check_string(T, 0);
-    
+
+    /* The command's output follows anything printed so far */
+    tea_state_flush(T);
     tea_push_number(T, system(arg));
 }
 
+#if defined(TEA_USE_POSIX)
+
+enum { STREAM_PIPE, STREAM_INHERIT, STREAM_NULL, STREAM_STDOUT };
+
+/* How the child gets one of its standard streams, a pipe unless asked otherwise */
+static int stream_option(TeaState* T, TeaObjectMap* options, const char* name, bool merge)
+{
+    static const char* const modes[] = { "pipe", "inherit", "null", "stdout", NULL };
+
+    TeaValue mode;
+    if(options == NULL || !tea_map_get(options, OBJECT_VAL(tea_string_new(T, name)), &mode))
+        return STREAM_PIPE;
+
+    if(IS_STRING(mode))
+    {
+        for(int i = 0; modes[i] != NULL && (merge || i != STREAM_STDOUT); i++)
+        {
+            if(strcmp(modes[i], AS_CSTRING(mode)) == 0)
+                return i;
+        }
+    }
+    tea_error(T, "Invalid %s option", name);
+    return STREAM_PIPE;
+}
+
+static void close_pipes(int pipes[3][2])
+{
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 2; j++)
+        {
+            if(pipes[i][j] >= 0)
+                close(pipes[i][j]);
+        }
+    }
+}
+
+static void set_stream(TeaState* T, int fd, const char* name, const char* mode, TeaObjectString* path)
+{
+    if(fd < 0)
+    {
+        tea_push_null(T);
+    }
+    else
+    {
+        tea_push_string(T, mode);
+        TeaObjectFile* file = tea_obj_new_file(T, path, AS_STRING(T->top[-1]));
+        file->file = fdopen(fd, mode);
+        T->top[-1] = OBJECT_VAL(file);
+    }
+    tea_set_key(T, -2, name);
+}
+
+/*
+** spawn(command, options = {}) starts a child without waiting for it. A
+** list runs a program found on the path with those arguments, a string runs
+** through the shell. Each of stdin, stdout and stderr is a pipe to the child
+** unless options says "inherit" or "null", stderr can also be "stdout"
+*/
+static void os_spawn(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    int argc;
+    if(tea_is_list(T, 0))
+    {
+        argc = tea_len(T, 0);
+        if(argc == 0)
+        {
+            tea_error(T, "Expected a program to run");
+        }
+        TeaObjectList* list = AS_LIST(T->base[0]);
+        for(int i = 0; i < argc; i++)
+        {
+            if(!IS_STRING(list->items.values[i]))
+            {
+                tea_error(T, "Expected a list of strings");
+            }
+        }
+    }
+    else
+    {
+        tea_check_string(T, 0);
+        argc = 3;
+    }
+
+    TeaObjectMap* options = NULL;
+    if(count == 2 && !tea_is_null(T, 1))
+    {
+        tea_check_map(T, 1);
+        options = AS_MAP(T->base[1]);
+    }
+    int modes[3];
+    modes[0] = stream_option(T, options, "stdin", false);
+    modes[1] = stream_option(T, options, "stdout", false);
+    modes[2] = stream_option(T, options, "stderr", true);
+
+    int pipes[3][2] = { { -1, -1 }, { -1, -1 }, { -1, -1 } };
+    for(int i = 0; i < 3; i++)
+    {
+        if(modes[i] != STREAM_PIPE)
+            continue;
+
+        /* Both ends close on exec, the child only keeps the copies it is given */
+        if(pipe(pipes[i]) != 0)
+        {
+            int err = errno;
+            close_pipes(pipes);
+            tea_error(T, "Unable to create pipe: %s", strerror(err));
+        }
+        fcntl(pipes[i][0], F_SETFD, FD_CLOEXEC);
+        fcntl(pipes[i][1], F_SETFD, FD_CLOEXEC);
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for(int i = 0; i < 3; i++)
+    {
+        switch(modes[i])
+        {
+            case STREAM_PIPE:
+                /* The child reads its stdin and writes the others */
+                posix_spawn_file_actions_adddup2(&actions, pipes[i][i == 0 ? 0 : 1], i);
+                break;
+            case STREAM_NULL:
+                posix_spawn_file_actions_addopen(&actions, i, "/dev/null", i == 0 ? O_RDONLY : O_WRONLY, 0);
+                break;
+            case STREAM_STDOUT:
+                posix_spawn_file_actions_adddup2(&actions, 1, 2);
+                break;
+        }
+    }
+
+    char** argv = TEA_ALLOCATE(T, char*, argc + 1);
+    if(tea_is_list(T, 0))
+    {
+        TeaObjectList* list = AS_LIST(T->base[0]);
+        for(int i = 0; i < argc; i++)
+        {
+            argv[i] = AS_CSTRING(list->items.values[i]);
+        }
+    }
+    else
+    {
+        argv[0] = "sh";
+        argv[1] = "-c";
+        argv[2] = (char*)tea_get_string(T, 0);
+    }
+    argv[argc] = NULL;
+
+    /* The child's output follows anything printed so far */
+    tea_state_flush(T);
+
+    /* The child starts with the default SIGPIPE even when it is ignored here */
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    extern char** environ;
+    pid_t pid;
+    int err = tea_is_list(T, 0) ?
+        posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ) :
+        posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    TEA_FREE_ARRAY(T, char*, argv, argc + 1);
+
+    /* The parent keeps the other end of each pipe */
+    int ends[3];
+    for(int i = 0; i < 3; i++)
+    {
+        int keep = i == 0 ? 1 : 0;
+        ends[i] = pipes[i][keep];
+        pipes[i][keep] = -1;
+    }
+    close_pipes(pipes);
+
+    if(err != 0)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            if(ends[i] >= 0)
+                close(ends[i]);
+        }
+        tea_error(T, "Unable to run '%s': %s", tea_is_list(T, 0) ? AS_CSTRING(AS_LIST(T->base[0])->items.values[0]) : "/bin/sh", strerror(err));
+    }
+
+    TeaObjectString* path = tea_is_list(T, 0) ? AS_STRING(AS_LIST(T->base[0])->items.values[0]) : AS_STRING(T->base[0]);
+    tea_new_map(T);
+    tea_push_number(T, pid);
+    tea_set_key(T, -2, "pid");
+    set_stream(T, ends[0], "stdin", "w", path);
+    set_stream(T, ends[1], "stdout", "r", path);
+    set_stream(T, ends[2], "stderr", "r", path);
+}
+
+/*
+** wait(pid, block = true) returns the exit status of a spawned child, or
+** 128 plus the signal that ended it. Without blocking, null while it runs
+*/
+static void os_wait(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    pid_t pid = (pid_t)tea_check_number(T, 0);
+    bool block = tea_opt_bool(T, 1, true);
+
+    int status;
+    pid_t done;
+    do
+    {
+        done = waitpid(pid, &status, block ? 0 : WNOHANG);
+    }
+    while(done < 0 && errno == EINTR);
+
+    if(done < 0)
+    {
+        tea_error(T, "Unable to wait for %d: %s", (int)pid, strerror(errno));
+    }
+    if(done == 0)
+    {
+        tea_push_null(T);
+        return;
+    }
+
+    if(WIFEXITED(status))
+        tea_push_number(T, WEXITSTATUS(status));
+    else if(WIFSIGNALED(status))
+        tea_push_number(T, 128 + WTERMSIG(status));
+    else
+        tea_push_number(T, status);
+}
+
+/* kill(pid, signal = 15) sends a signal, terminating the child by default */
+static void os_kill(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    pid_t pid = (pid_t)tea_check_number(T, 0);
+    int sig = (int)tea_opt_number(T, 1, SIGTERM);
+    tea_push_bool(T, kill(pid, sig) == 0);
+}
+
+#else
+
+static void os_unsupported(TeaState* T)
+{
+    tea_error(T, "Processes are not supported on this platform");
+}
+
+#define os_spawn os_unsupported
+#define os_wait os_unsupported
+#define os_kill os_unsupported
+
+#endif
+
 static inline const char* os_name()
 {
 #if defined(_WIN32) || defined(_WIN64)
@@ -141,6 +421,9 @@ static const TeaModule os_module[] = {
     { "getenv", os_getenv },
     { "setenv", os_setenv },
     { "system", os_system },
+    { "spawn", os_spawn },
+    { "wait", os_wait },
+    { "kill", os_kill },
     { "name", NULL },
     { "env", NULL },
     { NULL, NULL }
@@ -16,6 +16,7 @@
 #include "tea_scanner.h"
 #include "tea_string.h"
 #include "tea_utf.h"
+#include "tea_strscan.h"
 
 void tea_scanner_init(TeaState* T, TeaScanner* scanner, const char* source)
 {
@@ -406,7 +407,10 @@ static TeaToken make_number_token(TeaScanner* scanner, bool strip, bool is_hex,
         }
         else 
         {
-            value = NUMBER_VAL(strtod(buffer, NULL));
+            double n;
+            if(!tea_strscan_number(buffer, (int)(current - buffer), &n))
+                errno = ERANGE;
+            value = NUMBER_VAL(n);
         }
         
         TEA_FREE_ARRAY(scanner->T, char, buffer, len + 1);
@@ -427,7 +431,10 @@ static TeaToken make_number_token(TeaScanner* scanner, bool strip, bool is_hex,
     }
     else 
     {
-		value = NUMBER_VAL(strtod(scanner->start, NULL));
+        double n;
+        if(!tea_strscan_number(scanner->start, (int)(scanner->current - scanner->start), &n))
+            errno = ERANGE;
+        value = NUMBER_VAL(n);
 	}
 
     done:
@@ -0,0 +1,131 @@
+/*
+** tea_set.c
+** Teascript set implementation
+*/
+
+#define tea_set_c
+#define TEA_CORE
+
+#include "tea_set.h"
+#include "tea_map.h"
+
+TeaObjectSet* tea_set_new(TeaState* T)
+{
+    TeaObjectSet* set = ALLOCATE_OBJECT(T, TeaObjectSet, OBJ_SET);
+    set->count = 0;
+    set->used = 0;
+    set->capacity = 0;
+    set->index_size = 0;
+    set->index = NULL;
+    set->items = NULL;
+
+    return set;
+}
+
+void tea_set_clear(TeaState* T, TeaObjectSet* set)
+{
+    TEA_FREE_ARRAY(T, TeaValue, set->items, set->capacity);
+    tea_map_index_free(T, set->index, set->index_size);
+    set->items = NULL;
+    set->index = NULL;
+    set->index_size = 0;
+    set->capacity = 0;
+    set->used = 0;
+    set->count = 0;
+}
+
+static inline int set_lookup(TeaObjectSet* set, TeaValue value, uint32_t hash, uint32_t* slot)
+{
+    return tea_map_index_lookup(set->index, set->index_size, set->items, 1, value, hash, slot);
+}
+
+bool tea_set_contains(TeaObjectSet* set, TeaValue value)
+{
+    if(set->count == 0)
+        return false;
+
+    uint32_t slot;
+    return set_lookup(set, value, tea_map_hash(value), &slot) >= 0;
+}
+
+/* Compacts the live items in order into a table sized for count of them */
+static void set_resize(TeaState* T, TeaObjectSet* set, int count)
+{
+    int index_size = tea_map_index_size(count);
+    int capacity = index_size * 2 / 3;
+
+    TeaValue* items = TEA_ALLOCATE(T, TeaValue, capacity);
+
+    int used = 0;
+    for(int i = 0; i < set->used; i++)
+    {
+        if(SET_ITEM_EMPTY(set->items[i]))
+            continue;
+        items[used++] = set->items[i];
+    }
+
+    void* index = tea_map_index_build(T, index_size, items, 1, used);
+
+    TEA_FREE_ARRAY(T, TeaValue, set->items, set->capacity);
+    tea_map_index_free(T, set->index, set->index_size);
+    set->items = items;
+    set->index = index;
+    set->index_size = index_size;
+    set->capacity = capacity;
+    set->used = used;
+}
+
+bool tea_set_add(TeaState* T, TeaObjectSet* set, TeaValue value)
+{
+    uint32_t hash = tea_map_hash(value);
+    uint32_t slot;
+
+    if(set->count > 0 && set_lookup(set, value, hash, &slot) >= 0)
+        return false;
+
+    if(set->used == set->capacity)
+    {
+        set_resize(T, set, set->count + 1);
+    }
+    set_lookup(set, value, hash, &slot);
+
+    set->items[set->used] = value;
+    tea_map_index_set(set->index, set->index_size, slot, set->used);
+    set->used++;
+    set->count++;
+
+    return true;
+}
+
+bool tea_set_delete(TeaState* T, TeaObjectSet* set, TeaValue value)
+{
+    if(set->count == 0)
+        return false;
+
+    uint32_t slot;
+    int offset = set_lookup(set, value, tea_map_hash(value), &slot);
+    if(offset < 0)
+        return false;
+
+    tea_map_index_set(set->index, set->index_size, slot, MAP_INDEX_DELETED);
+    set->items[offset] = MAP_EMPTY_KEY;
+    set->count--;
+
+    if(set->count == 0)
+    {
+        tea_set_clear(T, set);
+    }
+
+    return true;
+}
+
+void tea_set_add_all(TeaState* T, TeaObjectSet* from, TeaObjectSet* to)
+{
+    for(int i = 0; i < from->used; i++)
+    {
+        if(!SET_ITEM_EMPTY(from->items[i]))
+        {
+            tea_set_add(T, to, from->items[i]);
+        }
+    }
+}
@@ -0,0 +1,19 @@
+/*
+** tea_set.h
+** Teascript set implementation
+*/
+
+#ifndef TEA_SET_H
+#define TEA_SET_H
+
+#include "tea_object.h"
+
+TeaObjectSet* tea_set_new(TeaState* T);
+
+void tea_set_clear(TeaState* T, TeaObjectSet* set);
+bool tea_set_add(TeaState* T, TeaObjectSet* set, TeaValue value);
+bool tea_set_contains(TeaObjectSet* set, TeaValue value);
+bool tea_set_delete(TeaState* T, TeaObjectSet* set, TeaValue value);
+void tea_set_add_all(TeaState* T, TeaObjectSet* from, TeaObjectSet* to);
+
+#endif
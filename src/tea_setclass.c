@@ -0,0 +1,288 @@
+/*
+** tea_setclass.c
+** Teascript set class
+*/
+
+#define tea_setclass_c
+#define TEA_CORE
+
+#include "tea_vm.h"
+#include "tea_core.h"
+#include "tea_map.h"
+#include "tea_set.h"
+
+/* Adds every item of the list, set, map keys or range at index to set */
+static void set_add_from(TeaState* T, TeaObjectSet* set, int index)
+{
+    TeaValue value = T->base[index];
+
+    if(IS_SET(value))
+    {
+        tea_set_add_all(T, AS_SET(value), set);
+        return;
+    }
+
+    if(IS_LIST(value))
+    {
+        TeaObjectList* list = AS_LIST(value);
+        for(int i = 0; i < list->items.count; i++)
+        {
+            tea_set_add(T, set, list->items.values[i]);
+        }
+        return;
+    }
+
+    if(IS_MAP(value))
+    {
+        TeaObjectMap* map = AS_MAP(value);
+        for(int i = 0; i < map->used; i++)
+        {
+            if(MAP_ITEM_EMPTY(&map->items[i])) continue;
+            tea_set_add(T, set, map->items[i].key);
+        }
+        return;
+    }
+
+    if(IS_RANGE(value))
+    {
+        double start, end, step;
+        tea_get_range(T, index, &start, &end, &step);
+        if(step < 0) step = -step;
+        if(step == 0) step = 1;
+
+        /* Same direction as iterating the range, end excluded */
+        if(start <= end)
+        {
+            for(double i = start; i < end; i += step)
+                tea_set_add(T, set, NUMBER_VAL(i));
+        }
+        else
+        {
+            for(double i = start; i > end; i -= step)
+                tea_set_add(T, set, NUMBER_VAL(i));
+        }
+        return;
+    }
+
+    tea_error(T, "Expected a list, set, map or range, got %s", tea_type_name(T, index));
+}
+
+/* Sets an operand up for a set operation, lists are hashed once up front */
+static void check_operand(TeaState* T, int index)
+{
+    if(tea_is_set(T, index))
+        return;
+
+    if(!tea_is_list(T, index))
+    {
+        tea_error(T, "Expected a set or list, got %s", tea_type_name(T, index));
+    }
+
+    tea_new_set(T);
+    set_add_from(T, AS_SET(T->top[-1]), index);
+    T->base[index] = T->top[-1];
+    tea_pop(T, 1);
+}
+
+static void set_constructor(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count > 2, "Expected 0 or 1 argument, got %d", count - 1);
+
+    tea_new_set(T);
+    if(count == 2)
+    {
+        set_add_from(T, AS_SET(T->top[-1]), 1);
+    }
+}
+
+static void set_len(TeaState* T)
+{
+    tea_push_number(T, tea_len(T, 0));
+}
+
+static void set_add(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    tea_set_add(T, AS_SET(T->base[0]), T->base[1]);
+    tea_pop(T, 1);
+}
+
+static void set_contains(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    tea_push_bool(T, tea_set_contains(AS_SET(T->base[0]), T->base[1]));
+}
+
+static void set_delete(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    if(!tea_set_delete(T, AS_SET(T->base[0]), T->base[1]))
+    {
+        tea_error(T, "No such value in the set");
+    }
+    tea_pop(T, 1);
+}
+
+static void set_clear(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 1);
+
+    tea_set_clear(T, AS_SET(T->base[0]));
+}
+
+static void set_copy(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 1);
+
+    tea_new_set(T);
+    tea_set_add_all(T, AS_SET(T->base[0]), AS_SET(T->top[-1]));
+}
+
+static void set_union(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    check_operand(T, 1);
+
+    tea_new_set(T);
+    TeaObjectSet* set = AS_SET(T->top[-1]);
+    tea_set_add_all(T, AS_SET(T->base[0]), set);
+    tea_set_add_all(T, AS_SET(T->base[1]), set);
+}
+
+static void set_intersection(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    check_operand(T, 1);
+
+    tea_new_set(T);
+    TeaObjectSet* set = AS_SET(T->top[-1]);
+    TeaObjectSet* self = AS_SET(T->base[0]);
+    TeaObjectSet* other = AS_SET(T->base[1]);
+    for(int i = 0; i < self->used; i++)
+    {
+        TeaValue value = self->items[i];
+        if(!SET_ITEM_EMPTY(value) && tea_set_contains(other, value))
+        {
+            tea_set_add(T, set, value);
+        }
+    }
+}
+
+static void set_difference(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 1 argument, got %d", count - 1);
+    check_operand(T, 1);
+
+    tea_new_set(T);
+    TeaObjectSet* set = AS_SET(T->top[-1]);
+    TeaObjectSet* self = AS_SET(T->base[0]);
+    TeaObjectSet* other = AS_SET(T->base[1]);
+    for(int i = 0; i < self->used; i++)
+    {
+        TeaValue value = self->items[i];
+        if(!SET_ITEM_EMPTY(value) && !tea_set_contains(other, value))
+        {
+            tea_set_add(T, set, value);
+        }
+    }
+}
+
+static void set_iterate(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    TeaObjectSet* set = AS_SET(T->base[0]);
+    if(set->count == 0)
+    {
+        tea_push_null(T);
+        return;
+    }
+
+    /* If we're starting the iteration, start at the first used entry */
+    int index = 0;
+
+    /* Otherwise, start one past the last entry we stopped at */
+    if(!tea_is_null(T, 1))
+    {
+        if(!tea_is_number(T, 1))
+        {
+            tea_error(T, "Expected a number to iterate");
+        }
+
+        index = tea_get_number(T, 1);
+        if(index < 0 || index >= set->used)
+        {
+            tea_push_null(T);
+            return;
+        }
+
+        /* Advance the iterator */
+        index++;
+    }
+
+    /* Find a used entry, if any */
+    for(; index < set->used; index++)
+    {
+        if(!SET_ITEM_EMPTY(set->items[index]))
+        {
+            tea_push_number(T, index);
+            return;
+        }
+    }
+
+    /* If we get here, walked all of the entries */
+    tea_push_null(T);
+}
+
+static void set_iteratorvalue(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_ensure_min_args(T, count, 2);
+
+    TeaObjectSet* set = AS_SET(T->base[0]);
+    int index = tea_check_number(T, 1);
+
+    if(index < 0 || index >= set->used || SET_ITEM_EMPTY(set->items[index]))
+    {
+        tea_error(T, "Invalid set iterator");
+    }
+
+    tea_vm_push(T, set->items[index]);
+}
+
+static const TeaClass set_class[] = {
+    { "constructor", "method", set_constructor },
+    { "len", "property", set_len },
+    { "add", "method", set_add },
+    { "contains", "method", set_contains },
+    { "delete", "method", set_delete },
+    { "clear", "method", set_clear },
+    { "copy", "method", set_copy },
+    { "union", "method", set_union },
+    { "intersection", "method", set_intersection },
+    { "difference", "method", set_difference },
+    { "iterate", "method", set_iterate },
+    { "iteratorvalue", "method", set_iteratorvalue },
+    { NULL, NULL, NULL }
+};
+
+void tea_open_set(TeaState* T)
+{
+    tea_create_class(T, TEA_SET_CLASS, set_class);
+    T->set_class = AS_CLASS(T->top[-1]);
+    tea_set_global(T, TEA_SET_CLASS);
+    tea_push_null(T);
+}
@@ -0,0 +1,552 @@
+/*
+** tea_socketlib.c
+** Teascript socket module
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define tea_socketlib_c
+#define TEA_LIB
+
+#include "tea.h"
+#include "tealib.h"
+
+#include "tea_import.h"
+#include "tea_core.h"
+#include "tea_state.h"
+
+#if defined(TEA_USE_POSIX)
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#if defined(TEA_USE_LINUX)
+#include <sys/sendfile.h>
+#endif
+
+/* Without MSG_NOSIGNAL, send holds SIGPIPE off like writev does */
+#if defined(TEA_USE_POSIX) && !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#define SOCKET_SEND_SIGPIPE
+#endif
+
+/* Largest receive done by socket.recv in one call */
+#define SOCKET_RECV_MAX 65536
+
+/* Iovecs handed to one writev call */
+#define SOCKET_IOV_MAX 64
+
+#if defined(TEA_USE_POSIX)
+
+static bool would_block()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+static int sock_fd(TeaState* T, int index)
+{
+    double fd = tea_check_number(T, index);
+    if(fd < 0 || fd != (int)fd)
+    {
+        tea_error(T, "Expected a socket");
+    }
+    return (int)fd;
+}
+
+/* Bytes to send, strings and buffers go out as they are */
+static const char* sock_data(TeaState* T, int index, int* len)
+{
+    if(tea_is_buffer(T, index))
+    {
+        return tea_to_buffer(T, index, len);
+    }
+    return tea_check_lstring(T, index, len);
+}
+
+/* Narrows data to the optional offset and size arguments that follow it */
+static const char* sock_range(TeaState* T, int index, int* len)
+{
+    const char* data = sock_data(T, index, len);
+    double offset = tea_opt_number(T, index + 1, 0);
+    if(offset < 0 || offset > *len)
+    {
+        tea_error(T, "Offset out of bounds");
+    }
+    double n = tea_opt_number(T, index + 2, *len - offset);
+    if(n < 0 || n > *len - offset)
+    {
+        tea_error(T, "Expected a size that fits in the data");
+    }
+    *len = (int)n;
+    return data + (int)offset;
+}
+
+/*
+** Makes a stream socket for a Unix path when no port is given, otherwise
+** for the host and port, then binds or connects it
+*/
+static int sock_open(TeaState* T, int count, bool server)
+{
+    int fd;
+    if(count == 1 || tea_is_null(T, 1))
+    {
+        int len;
+        const char* path = tea_check_lstring(T, 0, &len);
+
+        struct sockaddr_un addr;
+        if(len >= (int)sizeof(addr.sun_path))
+        {
+            tea_error(T, "Socket path is too long");
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path, len);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0)
+        {
+            tea_error(T, "Unable to create socket: %s", strerror(errno));
+        }
+        int rc = server ? bind(fd, (struct sockaddr*)&addr, sizeof(addr)) : connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+        if(rc != 0)
+        {
+            int err = errno;
+            close(fd);
+            tea_error(T, "Unable to %s '%s': %s", server ? "listen on" : "connect to", path, strerror(err));
+        }
+    }
+    else
+    {
+        const char* host = tea_check_string(T, 0);
+        double port = tea_check_number(T, 1);
+        if(port < 0 || port > 65535 || port != (int)port)
+        {
+            tea_error(T, "Expected a port from 0 to 65535");
+        }
+
+        char service[8];
+        snprintf(service, sizeof(service), "%d", (int)port);
+
+        struct addrinfo hints, *list;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = server ? AI_PASSIVE : 0;
+
+        int err = getaddrinfo(host, service, &hints, &list);
+        if(err != 0)
+        {
+            tea_error(T, "Unable to resolve '%s': %s", host, gai_strerror(err));
+        }
+
+        fd = -1;
+        err = 0;
+        for(struct addrinfo* ai = list; ai != NULL; ai = ai->ai_next)
+        {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if(fd < 0)
+            {
+                err = errno;
+                continue;
+            }
+
+            int one = 1;
+            if(server)
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            else
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            if((server ? bind(fd, ai->ai_addr, ai->ai_addrlen) : connect(fd, ai->ai_addr, ai->ai_addrlen)) == 0)
+                break;
+
+            err = errno;
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(list);
+
+        if(fd < 0)
+        {
+            tea_error(T, "Unable to %s %s:%d: %s", server ? "listen on" : "connect to", host, (int)port, strerror(err));
+        }
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/* listen(path) or listen(host, port, backlog = 128) */
+static void socket_listen(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 3, "Expected 1 to 3 arguments, got %d", count);
+
+    int backlog = (int)tea_opt_number(T, 2, 128);
+    int fd = sock_open(T, count, true);
+    if(listen(fd, backlog) != 0)
+    {
+        int err = errno;
+        close(fd);
+        tea_error(T, "Unable to listen: %s", strerror(err));
+    }
+    tea_push_number(T, fd);
+}
+
+/* connect(path) or connect(host, port) */
+static void socket_connect(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    tea_push_number(T, sock_open(T, count, false));
+}
+
+/* The next connection, or null when a non blocking socket has none waiting */
+static void socket_accept(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    int client = accept(fd, NULL, NULL);
+    if(client < 0)
+    {
+        if(would_block() || errno == ECONNABORTED)
+        {
+            tea_push_null(T);
+            return;
+        }
+        tea_error(T, "Unable to accept: %s", strerror(errno));
+    }
+
+    fcntl(client, F_SETFD, FD_CLOEXEC);
+    tea_push_number(T, client);
+}
+
+/* The local port a TCP socket is bound to, useful after listening on port 0 */
+static void socket_port(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if(getsockname(sock_fd(T, 0), (struct sockaddr*)&addr, &len) != 0)
+    {
+        tea_error(T, "Unable to get the socket address: %s", strerror(errno));
+    }
+
+    if(addr.ss_family == AF_INET)
+        tea_push_number(T, ntohs(((struct sockaddr_in*)&addr)->sin_port));
+    else if(addr.ss_family == AF_INET6)
+        tea_push_number(T, ntohs(((struct sockaddr_in6*)&addr)->sin6_port));
+    else
+        tea_push_null(T);
+}
+
+static void socket_nonblock(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    bool on = tea_opt_bool(T, 1, true);
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETFL, on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) < 0)
+    {
+        tea_error(T, "Unable to change socket: %s", strerror(errno));
+    }
+    tea_push_null(T);
+}
+
+/* Receives what is available, "" when it would block and null at the end */
+static void socket_recv(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    double max = tea_opt_number(T, 1, SOCKET_RECV_MAX);
+    if(max < 1 || max > SOCKET_RECV_MAX)
+    {
+        tea_error(T, "Expected a size from 1 to %d", SOCKET_RECV_MAX);
+    }
+
+    char chars[SOCKET_RECV_MAX];
+    ssize_t n = recv(fd, chars, (size_t)max, 0);
+    if(n < 0)
+    {
+        if(would_block())
+        {
+            tea_push_literal(T, "");
+            return;
+        }
+        tea_error(T, "Unable to receive: %s", strerror(errno));
+    }
+    if(n == 0)
+    {
+        tea_push_null(T);
+        return;
+    }
+    tea_push_lstring(T, chars, (int)n);
+}
+
+/*
+** recvinto(socket, buffer, offset = 0, n = rest) receives straight into the
+** buffer, returning the bytes taken, 0 at the end or null when it would block
+*/
+static void socket_recvinto(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 4, "Expected 2 to 4 arguments, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    tea_check_buffer(T, 1);
+
+    int len;
+    char* bytes = tea_to_buffer(T, 1, &len);
+    double offset = tea_opt_number(T, 2, 0);
+    if(offset < 0 || offset > len)
+    {
+        tea_error(T, "Buffer offset out of bounds");
+    }
+    double n = tea_opt_number(T, 3, len - offset);
+    if(n < 0 || n > len - offset)
+    {
+        tea_error(T, "Expected a size that fits in the buffer");
+    }
+
+    ssize_t got = recv(fd, bytes + (int)offset, (size_t)n, 0);
+    if(got < 0)
+    {
+        if(would_block())
+        {
+            tea_push_null(T);
+            return;
+        }
+        tea_error(T, "Unable to receive: %s", strerror(errno));
+    }
+    tea_push_number(T, got);
+}
+
+/* send(socket, data, offset = 0, n = rest) returns the bytes taken, 0 when it would block */
+static void socket_send(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 4, "Expected 2 to 4 arguments, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    int len;
+    const char* data = sock_range(T, 1, &len);
+
+#if defined(SOCKET_SEND_SIGPIPE)
+    bool held = tea_file_hold_sigpipe();
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    tea_file_release_sigpipe(held);
+#else
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+#endif
+    if(n < 0)
+    {
+        if(!would_block())
+        {
+            tea_error(T, "Unable to send: %s", strerror(errno));
+        }
+        n = 0;
+    }
+    tea_push_number(T, n);
+}
+
+/* Gathers a list of strings and buffers into as few writes as it can */
+static void socket_writev(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 2, "Expected 2 arguments, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    tea_check_list(T, 1);
+
+    struct iovec iov[SOCKET_IOV_MAX];
+    int items = tea_len(T, 1);
+    double total = 0;
+
+    for(int i = 0; i < items; i += SOCKET_IOV_MAX)
+    {
+        int batch = items - i < SOCKET_IOV_MAX ? items - i : SOCKET_IOV_MAX;
+        size_t want = 0;
+        for(int j = 0; j < batch; j++)
+        {
+            int len;
+            tea_get_item(T, 1, i + j);
+            iov[j].iov_base = (void*)sock_data(T, -1, &len);
+            iov[j].iov_len = len;
+            want += len;
+            /* Still held by the list */
+            tea_pop(T, 1);
+        }
+
+        /* A peer going away shows up as an error from the write, not a signal */
+        bool held = tea_file_hold_sigpipe();
+        ssize_t n = writev(fd, iov, batch);
+        tea_file_release_sigpipe(held);
+        if(n < 0)
+        {
+            if(!would_block())
+            {
+                tea_error(T, "Unable to send: %s", strerror(errno));
+            }
+            break;
+        }
+        total += n;
+        if((size_t)n < want)
+            break;
+    }
+    tea_push_number(T, total);
+}
+
+/*
+** sendfile(socket, file, offset = 0, n = rest) sends part of an open file
+** without it passing through the interpreter, returning the bytes sent
+*/
+static void socket_sendfile(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 2 || count > 4, "Expected 2 to 4 arguments, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    tea_check_file(T, 1);
+    TeaObjectFile* file = AS_FILE(T->base[1]);
+    if(!file->is_open)
+    {
+        tea_error(T, "File is closed");
+    }
+
+    int in = fileno(file->file);
+    struct stat st;
+    if(fstat(in, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        tea_error(T, "Expected a regular file");
+    }
+
+    double offset = tea_opt_number(T, 2, 0);
+    if(offset < 0 || offset > st.st_size)
+    {
+        tea_error(T, "File offset out of bounds");
+    }
+    double n = tea_opt_number(T, 3, st.st_size - offset);
+    if(n < 0 || n > st.st_size - offset)
+    {
+        tea_error(T, "Expected a size that fits in the file");
+    }
+
+    off_t pos = (off_t)offset;
+    size_t left = (size_t)n;
+    size_t sent = 0;
+    while(left > 0)
+    {
+        bool held = tea_file_hold_sigpipe();
+#if defined(TEA_USE_LINUX)
+        ssize_t done = sendfile(fd, in, &pos, left);
+#else
+        char chunk[SOCKET_RECV_MAX];
+        ssize_t done = pread(in, chunk, left < sizeof(chunk) ? left : sizeof(chunk), pos);
+        if(done > 0)
+        {
+            done = send(fd, chunk, done, MSG_NOSIGNAL);
+            if(done > 0)
+                pos += done;
+        }
+#endif
+        tea_file_release_sigpipe(held);
+        if(done < 0)
+        {
+            if(would_block())
+                break;
+            tea_error(T, "Unable to send file: %s", strerror(errno));
+        }
+        if(done == 0)
+            break;
+        sent += done;
+        left -= done;
+    }
+    tea_push_number(T, sent);
+}
+
+/* shutdown(socket, how = "rw") ends reading, writing or both */
+static void socket_shutdown(TeaState* T)
+{
+    static const char* const modes[] = { "r", "w", "rw", NULL };
+    static const int hows[] = { SHUT_RD, SHUT_WR, SHUT_RDWR };
+
+    int count = tea_get_top(T);
+    tea_check_args(T, count < 1 || count > 2, "Expected 1 or 2 arguments, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    int mode = tea_check_option(T, 1, "rw", modes);
+    tea_push_bool(T, shutdown(fd, hows[mode]) == 0);
+}
+
+static void socket_close(TeaState* T)
+{
+    int count = tea_get_top(T);
+    tea_check_args(T, count != 1, "Expected 1 argument, got %d", count);
+
+    int fd = sock_fd(T, 0);
+    tea_event_forget(T, fd);
+    tea_push_bool(T, close(fd) == 0);
+}
+
+#else
+
+static void socket_unsupported(TeaState* T)
+{
+    tea_error(T, "Sockets are not supported on this platform");
+}
+
+#define socket_listen socket_unsupported
+#define socket_connect socket_unsupported
+#define socket_accept socket_unsupported
+#define socket_port socket_unsupported
+#define socket_nonblock socket_unsupported
+#define socket_recv socket_unsupported
+#define socket_recvinto socket_unsupported
+#define socket_send socket_unsupported
+#define socket_writev socket_unsupported
+#define socket_sendfile socket_unsupported
+#define socket_shutdown socket_unsupported
+#define socket_close socket_unsupported
+
+#endif
+
+static const TeaModule socket_module[] = {
+    { "listen", socket_listen },
+    { "connect", socket_connect },
+    { "accept", socket_accept },
+    { "port", socket_port },
+    { "nonblock", socket_nonblock },
+    { "recv", socket_recv },
+    { "recvinto", socket_recvinto },
+    { "send", socket_send },
+    { "writev", socket_writev },
+    { "sendfile", socket_sendfile },
+    { "shutdown", socket_shutdown },
+    { "close", socket_close },
+    { NULL, NULL }
+};
+
+TEAMOD_API void tea_import_socket(TeaState* T)
+{
+    tea_create_module(T, TEA_SOCKET_MODULE, socket_module);
+}
@@ -3,8 +3,10 @@
 ** Teascript global state
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #define tea_state_c
 #define TEA_CORE
@@ -16,6 +18,11 @@
 #include "tea_util.h"
 #include "tea_do.h"
 #include "tea_gc.h"
+#include "tea_memory.h"
+
+#if defined(TEA_USE_POSIX)
+#include <unistd.h>
+#endif
 
 static void free_state(TeaState* T)
 {
@@ -42,6 +49,25 @@ static void init_stack(TeaState* T)
     T->open_upvalues = NULL;
 }
 
+static void init_strings(TeaState* T)
+{
+    for(int i = 0; i < UINT8_COUNT; i++)
+    {
+        T->char_strings[i] = NULL;
+    }
+    for(int i = 0; i < NUMBER_CACHE_SIZE; i++)
+    {
+        T->number_strings[i] = NULL;
+    }
+
+    /* Every single byte string lives for the whole state */
+    for(int i = 0; i < UINT8_COUNT; i++)
+    {
+        char c = (char)i;
+        T->char_strings[i] = tea_string_copy(T, &c, 1);
+    }
+}
+
 static void panic(TeaState* T)
 {
     fputs("PANIC: unprotected error in call to Teascript API", stderr);
@@ -73,6 +99,7 @@ TEA_API TeaState* tea_new_state(TeaAlloc f, void* ud)
     T->ud = ud;
     T->error_jump = NULL;
     T->objects = NULL;
+    T->compiler = NULL;
     T->last_module = NULL;
     T->bytes_allocated = 0;
     T->next_gc = 1024 * 1024;
@@ -84,23 +111,48 @@ TEA_API TeaState* tea_new_state(TeaAlloc f, void* ud)
     T->list_class = NULL;
     T->string_class = NULL;
     T->map_class = NULL;
+    T->set_class = NULL;
+    T->iter_class = NULL;
+    T->buffer_class = NULL;
+    T->iterate_string = NULL;
+    T->iteratorvalue_string = NULL;
     T->file_class = NULL;
     T->range_class = NULL;
     tea_table_init(&T->modules);
     tea_table_init(&T->globals);
     tea_table_init(&T->constants);
     tea_table_init(&T->strings);
+    init_strings(T);
     T->constructor_string = tea_string_literal(T, "constructor");
     T->repl_string = tea_string_literal(T, "_");
+    T->iterate_string = tea_string_literal(T, "iterate");
+    T->iteratorvalue_string = tea_string_literal(T, "iteratorvalue");
     T->repl = false;
+    T->out = NULL;
+    T->out_len = 0;
+    T->loop = NULL;
+    T->stdin_file = NULL;
+#if defined(TEA_USE_POSIX)
+    T->out_mode = isatty(STDOUT_FILENO) ? OUT_LINE : OUT_FULL;
+#else
+    T->out_mode = OUT_LINE;
+#endif
     tea_open_core(T);
     return T;
 }
 
 TEA_API void tea_close(TeaState* T)
 {
+    /* Nothing is left to report a broken pipe to */
+    tea_state_drain(T);
+    TEA_FREE_ARRAY(T, char, T->out, T->out != NULL ? OUT_BUFFER_SIZE : 0);
+    tea_event_close(T);
+
     T->constructor_string = NULL;
     T->repl_string = NULL;
+    T->iterate_string = NULL;
+    T->iteratorvalue_string = NULL;
+    T->stdin_file = NULL;
     
     if(T->repl) 
         tea_table_free(T, &T->constants);
@@ -127,6 +179,9 @@ TeaObjectClass* tea_state_get_class(TeaState* T, TeaValue value)
         {
             case OBJ_LIST: return T->list_class;
             case OBJ_MAP: return T->map_class;
+            case OBJ_SET: return T->set_class;
+            case OBJ_ITERATOR: return T->iter_class;
+            case OBJ_BUFFER: return T->buffer_class;
             case OBJ_STRING: return T->string_class;
             case OBJ_RANGE: return T->range_class;
             case OBJ_FILE: return T->file_class;
@@ -140,6 +195,9 @@ bool tea_state_isclass(TeaState* T, TeaObjectClass* klass)
 {
     return (klass == T->list_class ||
            klass == T->map_class ||
+           klass == T->set_class ||
+           klass == T->iter_class ||
+           klass == T->buffer_class ||
            klass == T->string_class ||
            klass == T->range_class ||
            klass == T->file_class);
@@ -161,4 +219,69 @@ TEA_API TeaInterpretResult tea_interpret(TeaState* T, const char* module_name, c
         return TEA_COMPILE_ERROR;
 
     return tea_do_pcall(T, T->top[-1], 0);
-}
\ No newline at end of file
+}
+
+/*
+** Writes chars straight to stdout and flushes, returns false only if the
+** reader of a pipe has gone away
+*/
+static bool write_stdout(const char* chars, size_t len)
+{
+    bool held = tea_file_hold_sigpipe();
+    bool ok = len == 0 || fwrite(chars, sizeof(char), len, stdout) == len;
+    ok = fflush(stdout) == 0 && ok;
+    bool broken = !ok && errno == EPIPE;
+    tea_file_release_sigpipe(held);
+
+    if(!ok)
+        clearerr(stdout);
+    return !broken;
+}
+
+static void broken_stdout(TeaState* T)
+{
+    tea_error(T, "Unable to write to 'stdout': %s", strerror(EPIPE));
+}
+
+/* Buffers standard output, writing it out as the mode asks */
+void tea_state_write(TeaState* T, const char* chars, size_t len)
+{
+    if(T->out == NULL)
+    {
+        T->out = TEA_ALLOCATE(T, char, OUT_BUFFER_SIZE);
+    }
+
+    if(T->out_len + len > OUT_BUFFER_SIZE)
+    {
+        tea_state_flush(T);
+        if(len >= OUT_BUFFER_SIZE)
+        {
+            /* Too big to be worth copying */
+            if(!write_stdout(chars, len))
+                broken_stdout(T);
+            return;
+        }
+    }
+
+    memcpy(T->out + T->out_len, chars, len);
+    T->out_len += len;
+
+    if(T->out_mode == OUT_NONE || (T->out_mode == OUT_LINE && memchr(chars, '\n', len) != NULL))
+    {
+        tea_state_flush(T);
+    }
+}
+
+/* Writes out the buffered output, returns false if stdout is a broken pipe */
+bool tea_state_drain(TeaState* T)
+{
+    size_t len = T->out_len;
+    T->out_len = 0;
+    return write_stdout(T->out, len);
+}
+
+void tea_state_flush(TeaState* T)
+{
+    if(!tea_state_drain(T))
+        broken_stdout(T);
+}
@@ -17,6 +17,21 @@
 #define BASIC_CI_SIZE 8
 #define BASE_STACK_SIZE (TEA_MIN_STACK * 2)
 
+#define NUMBER_CACHE_SIZE 256
+
+/* Size of the buffer shared by print and io.stdout */
+#define OUT_BUFFER_SIZE 65536
+
+typedef enum
+{
+    OUT_FULL,   /* Written when the buffer fills or on flush */
+    OUT_LINE,   /* Written at the end of every line */
+    OUT_NONE    /* Written straight away */
+} TeaOutMode;
+
+/* State of the event module, made on first import */
+typedef struct TeaEventLoop TeaEventLoop;
+
 typedef struct
 {
     TeaObjectClosure* closure;
@@ -46,10 +61,17 @@ typedef struct TeaState
     TeaObjectClass* string_class;
     TeaObjectClass* list_class;
     TeaObjectClass* map_class;
+    TeaObjectClass* set_class;
+    TeaObjectClass* iter_class;
+    TeaObjectClass* buffer_class;
     TeaObjectClass* file_class;
     TeaObjectClass* range_class;
     TeaObjectString* constructor_string;
     TeaObjectString* repl_string;
+    TeaObjectString* iterate_string;
+    TeaObjectString* iteratorvalue_string;
+    TeaObjectString* char_strings[UINT8_COUNT];
+    TeaObjectString* number_strings[NUMBER_CACHE_SIZE];
     TeaObject* objects;
     size_t bytes_allocated;
     size_t next_gc;
@@ -65,6 +87,11 @@ typedef struct TeaState
     int argf;
     bool repl;
     int nccalls;
+    char* out;
+    int out_len;
+    TeaOutMode out_mode;
+    TeaEventLoop* loop;
+    TeaObjectFile* stdin_file;
 } TeaState;
 
 #define TEA_THROW(T) (longjmp(T->error_jump->buf, 1))
@@ -72,5 +99,8 @@ typedef struct TeaState
 
 TeaObjectClass* tea_state_get_class(TeaState* T, TeaValue value);
 bool tea_state_isclass(TeaState* T, TeaObjectClass* klass);
+void tea_state_write(TeaState* T, const char* chars, size_t len);
+void tea_state_flush(TeaState* T);
+bool tea_state_drain(TeaState* T);
 
 #endif
\ No newline at end of file
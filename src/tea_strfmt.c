@@ -0,0 +1,752 @@
+/*
+** tea_strfmt.c
+** Teascript string formatting
+**
+** Non-integral numbers are printed with the shortest digit string that
+** reads back to the same double, using the Grisu2 algorithm by
+** Florian Loitsch ("Printing Floating-Point Numbers Quickly and
+** Accurately with Integers", PLDI 2010)
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define tea_strfmt_c
+#define TEA_CORE
+
+#include "tea_strfmt.h"
+#include "tea_state.h"
+#include "tea_memory.h"
+#include "tea_string.h"
+#include "tea_utf.h"
+#include "tea.h"
+
+typedef struct
+{
+    uint64_t f;
+    int e;
+} DiyFp;
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3ff + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT (-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK UINT64_C(0x7ff0000000000000)
+#define DP_SIGNIFICAND_MASK UINT64_C(0x000fffffffffffff)
+#define DP_HIDDEN_BIT UINT64_C(0x0010000000000000)
+
+/* Normalized 10^k for k = -348, -340, ..., 340 */
+static const uint64_t cached_powers_f[] = {
+    UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76),
+    UINT64_C(0xcf42894a5dce35ea), UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df),
+    UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f), UINT64_C(0xbe5691ef416bd60c),
+    UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+    UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57),
+    UINT64_C(0xc21094364dfb5637), UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7),
+    UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5), UINT64_C(0xb23867fb2a35b28e),
+    UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+    UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126),
+    UINT64_C(0xb5b5ada8aaff80b8), UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053),
+    UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd), UINT64_C(0xa6dfbd9fb8e5b88f),
+    UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+    UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06),
+    UINT64_C(0xaa242499697392d3), UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb),
+    UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c), UINT64_C(0x9c40000000000000),
+    UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+    UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068),
+    UINT64_C(0x9f4f2726179a2245), UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8),
+    UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a), UINT64_C(0x924d692ca61be758),
+    UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+    UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d),
+    UINT64_C(0x952ab45cfa97a0b3), UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25),
+    UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece), UINT64_C(0x88fcf317f22241e2),
+    UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+    UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410),
+    UINT64_C(0x8bab8eefb6409c1a), UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129),
+    UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429), UINT64_C(0x80444b5e7aa7cf85),
+    UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+    UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b)
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint64_t pow10_64[] = {
+    UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000),
+    UINT64_C(100000), UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000),
+    UINT64_C(1000000000), UINT64_C(10000000000), UINT64_C(100000000000),
+    UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+    UINT64_C(1000000000000000), UINT64_C(10000000000000000),
+    UINT64_C(100000000000000000), UINT64_C(1000000000000000000),
+    UINT64_C(10000000000000000000)
+};
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static DiyFp diyfp_from_double(double d)
+{
+    uint64_t u;
+    memcpy(&u, &d, sizeof(double));
+
+    int biased_e = (int)((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+    uint64_t significand = u & DP_SIGNIFICAND_MASK;
+
+    DiyFp fp;
+    if(biased_e != 0)
+    {
+        fp.f = significand + DP_HIDDEN_BIT;
+        fp.e = biased_e - DP_EXPONENT_BIAS;
+    }
+    else
+    {
+        fp.f = significand;
+        fp.e = DP_MIN_EXPONENT + 1;
+    }
+    return fp;
+}
+
+static DiyFp diyfp_mul(DiyFp x, DiyFp y)
+{
+    const uint64_t m32 = 0xffffffffu;
+    uint64_t a = x.f >> 32, b = x.f & m32;
+    uint64_t c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+    tmp += 1u << 31;    /* Round */
+
+    DiyFp r;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+
+static DiyFp diyfp_normalize(DiyFp x)
+{
+    while(!(x.f & (UINT64_C(1) << 63)))
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static void normalized_boundaries(DiyFp v, DiyFp* minus, DiyFp* plus)
+{
+    DiyFp pl, mi;
+    pl.f = (v.f << 1) + 1;
+    pl.e = v.e - 1;
+    pl = diyfp_normalize(pl);
+
+    if(v.f == DP_HIDDEN_BIT)
+    {
+        mi.f = (v.f << 2) - 1;
+        mi.e = v.e - 2;
+    }
+    else
+    {
+        mi.f = (v.f << 1) - 1;
+        mi.e = v.e - 1;
+    }
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+
+    *plus = pl;
+    *minus = mi;
+}
+
+static DiyFp cached_power(int e, int* k)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int)dk;
+    if(dk - ik > 0.0)
+        ik++;
+
+    unsigned index = (unsigned)((ik >> 3) + 1);
+    *k = -(-348 + (int)(index << 3));
+
+    DiyFp r;
+    r.f = cached_powers_f[index];
+    r.e = cached_powers_e[index];
+    return r;
+}
+
+static int count_digits32(uint32_t n)
+{
+    int count = 1;
+    while(n >= 10)
+    {
+        n /= 10;
+        count++;
+    }
+    return count;
+}
+
+static void grisu_round(char* buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while(rest < wp_w && delta - rest >= ten_kappa &&
+          (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+    {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static int digit_gen(DiyFp w, DiyFp mp, uint64_t delta, char* buffer, int* k)
+{
+    DiyFp one;
+    one.f = UINT64_C(1) << -mp.e;
+    one.e = mp.e;
+
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_digits32(p1);
+    int len = 0;
+
+    while(kappa > 0)
+    {
+        uint32_t div = (uint32_t)pow10_64[kappa - 1];
+        uint32_t d = p1 / div;
+        p1 %= div;
+        if(d || len)
+            buffer[len++] = (char)('0' + d);
+        kappa--;
+
+        uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+        if(tmp <= delta)
+        {
+            *k += kappa;
+            grisu_round(buffer, len, delta, tmp, pow10_64[kappa] << -one.e, wp_w);
+            return len;
+        }
+    }
+
+    while(true)
+    {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if(d || len)
+            buffer[len++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+
+        if(p2 < delta)
+        {
+            *k += kappa;
+            int index = -kappa;
+            grisu_round(buffer, len, delta, p2, one.f, wp_w * (index < 20 ? pow10_64[index] : 0));
+            return len;
+        }
+    }
+}
+
+/* Writes the shortest digits of a positive finite double, value = digits * 10^k */
+static int grisu2(double value, char* buffer, int* k)
+{
+    DiyFp v = diyfp_from_double(value);
+    DiyFp w_m, w_p;
+    normalized_boundaries(v, &w_m, &w_p);
+
+    DiyFp c_mk = cached_power(w_p.e, k);
+    DiyFp w = diyfp_mul(diyfp_normalize(v), c_mk);
+    DiyFp wp = diyfp_mul(w_p, c_mk);
+    DiyFp wm = diyfp_mul(w_m, c_mk);
+    wm.f++;
+    wp.f--;
+
+    return digit_gen(w, wp, wp.f - wm.f, buffer, k);
+}
+
+static int write_exponent(char* p, int e)
+{
+    char* start = p;
+    *p++ = 'e';
+    if(e < 0)
+    {
+        *p++ = '-';
+        e = -e;
+    }
+    else
+    {
+        *p++ = '+';
+    }
+
+    /* At least two digits, as printf does */
+    if(e >= 100)
+    {
+        *p++ = (char)('0' + e / 100);
+        e %= 100;
+    }
+    memcpy(p, digit_pairs + e * 2, 2);
+    p += 2;
+
+    return (int)(p - start);
+}
+
+int tea_strfmt_integer(char* buffer, int64_t n)
+{
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    uint64_t u = n < 0 ? (uint64_t)0 - (uint64_t)n : (uint64_t)n;
+
+    while(u >= 100)
+    {
+        int r = (int)(u % 100);
+        u /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + r * 2, 2);
+    }
+    if(u >= 10)
+    {
+        p -= 2;
+        memcpy(p, digit_pairs + u * 2, 2);
+    }
+    else
+    {
+        *--p = (char)('0' + u);
+    }
+    if(n < 0)
+        *--p = '-';
+
+    int len = (int)(tmp + sizeof(tmp) - p);
+    memcpy(buffer, p, len);
+    buffer[len] = '\0';
+
+    return len;
+}
+
+/* Formats a number the way "%.16g" lays it out, using the shortest round-trip digits */
+int tea_strfmt_number(char* buffer, double n)
+{
+    if(isnan(n))
+    {
+        memcpy(buffer, "nan", 4);
+        return 3;
+    }
+    if(isinf(n))
+    {
+        if(n > 0)
+        {
+            memcpy(buffer, "infinity", 9);
+            return 8;
+        }
+        memcpy(buffer, "-infinity", 10);
+        return 9;
+    }
+
+    /* Integer fast path, anything under 1e16 prints without an exponent */
+    if(n > -1e16 && n < 1e16 && n == (double)(int64_t)n)
+    {
+        if(n == 0 && signbit(n))
+        {
+            memcpy(buffer, "-0", 3);
+            return 2;
+        }
+        return tea_strfmt_integer(buffer, (int64_t)n);
+    }
+
+    char* p = buffer;
+    if(n < 0)
+    {
+        *p++ = '-';
+        n = -n;
+    }
+
+    char digits[20];
+    int k;
+    int len = grisu2(n, digits, &k);
+
+    /* Exponent of the first digit in scientific notation */
+    int exp = k + len - 1;
+
+    if(exp < -4 || exp >= 16)
+    {
+        *p++ = digits[0];
+        if(len > 1)
+        {
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        p += write_exponent(p, exp);
+    }
+    else if(exp < 0)
+    {
+        *p++ = '0';
+        *p++ = '.';
+        for(int i = -1; i > exp; i--)
+        {
+            *p++ = '0';
+        }
+        memcpy(p, digits, len);
+        p += len;
+    }
+    else if(exp + 1 >= len)
+    {
+        memcpy(p, digits, len);
+        p += len;
+        for(int i = len; i <= exp; i++)
+        {
+            *p++ = '0';
+        }
+    }
+    else
+    {
+        memcpy(p, digits, exp + 1);
+        p += exp + 1;
+        *p++ = '.';
+        memcpy(p, digits + exp + 1, len - exp - 1);
+        p += len - exp - 1;
+    }
+
+    *p = '\0';
+    return (int)(p - buffer);
+}
+
+/* ------------------------------------------------------------------------ */
+
+#define STRFMT_MAXWIDTH 999
+#define STRFMT_MAXBUF (STRFMT_MAXWIDTH + 320)
+
+static bool fmt_isdigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int scan_int(TeaState* T, TeaObjectString* fmt, int* i)
+{
+    const char* s = fmt->chars;
+    int n = 0;
+    while(*i < fmt->length && fmt_isdigit(s[*i]))
+    {
+        n = n * 10 + (s[(*i)++] - '0');
+        if(n > STRFMT_MAXWIDTH)
+            tea_error(T, "Format field too large in '%s'", s);
+    }
+    return n;
+}
+
+/* Splits a format string into specs, only counting them when specs is NULL */
+static int scan_format(TeaState* T, TeaObjectString* fmt, TeaFormatSpec* specs, int* nargs)
+{
+    const char* s = fmt->chars;
+    int len = fmt->length;
+    int count = 0;
+    int i = 0;
+
+    *nargs = 0;
+    while(i < len)
+    {
+        int start = i;
+        while(i < len && s[i] != '%')
+            i++;
+
+        TeaFormatSpec spec = { start, i - start, -1, 0, -1, 0, 0 };
+
+        /* "%%" stands for a single percent sign */
+        if(i + 1 < len && s[i + 1] == '%')
+        {
+            spec.length++;
+            i += 2;
+        }
+
+        if(spec.length > 0)
+        {
+            if(specs != NULL)
+                specs[count] = spec;
+            count++;
+        }
+        if(i >= len || s[i] != '%')
+            continue;
+
+        /* Conversion */
+        i++;
+        spec.start = spec.length = 0;
+        spec.arg = (*nargs)++;
+
+        for(; i < len; i++)
+        {
+            if(s[i] == '-')
+                spec.flags |= STRFMT_F_LEFT;
+            else if(s[i] == '0')
+                spec.flags |= STRFMT_F_ZERO;
+            else if(s[i] == '+')
+                spec.flags |= STRFMT_F_PLUS;
+            else if(s[i] == '^')
+                spec.flags |= STRFMT_F_CENTER;
+            else
+                break;
+        }
+
+        spec.width = scan_int(T, fmt, &i);
+
+        if(i < len && s[i] == '.')
+        {
+            i++;
+            if(i >= len || !fmt_isdigit(s[i]))
+                tea_error(T, "Missing precision in format string '%s'", s);
+            spec.precision = scan_int(T, fmt, &i);
+        }
+
+        if(i >= len || strchr("sdxXfeg", s[i]) == NULL)
+            tea_error(T, "Invalid conversion in format string '%s'", s);
+        spec.type = s[i++];
+
+        if(specs != NULL)
+            specs[count] = spec;
+        count++;
+    }
+
+    return count;
+}
+
+TeaFormat* tea_strfmt_parse(TeaState* T, TeaObjectString* fmt)
+{
+    int nargs;
+    int count = scan_format(T, fmt, NULL, &nargs);
+
+    TeaFormat* format = (TeaFormat*)tea_mem_realloc(T, NULL, 0, sizeof(TeaFormat) + sizeof(TeaFormatSpec) * count);
+    format->count = count;
+    scan_format(T, fmt, format->specs, &format->nargs);
+
+    fmt->format = format;
+    return format;
+}
+
+void tea_strfmt_free(TeaState* T, TeaObjectString* fmt)
+{
+    TeaFormat* format = fmt->format;
+    if(format != NULL)
+    {
+        tea_mem_realloc(T, format, sizeof(TeaFormat) + sizeof(TeaFormatSpec) * format->count, 0);
+        fmt->format = NULL;
+    }
+}
+
+typedef struct
+{
+    char* chars;
+    int length;
+    int capacity;
+} FormatBuffer;
+
+static char* buffer_need(TeaState* T, FormatBuffer* sb, int n)
+{
+    if(sb->length + n + 1 > sb->capacity)
+    {
+        int old_capacity = sb->capacity;
+        sb->capacity = TEA_GROW_CAPACITY(old_capacity);
+        if(sb->capacity < sb->length + n + 1)
+            sb->capacity = sb->length + n + 1;
+        sb->chars = TEA_GROW_ARRAY(T, char, sb->chars, old_capacity, sb->capacity);
+    }
+    return sb->chars + sb->length;
+}
+
+static void buffer_fill(TeaState* T, FormatBuffer* sb, char c, int n)
+{
+    if(n > 0)
+    {
+        memset(buffer_need(T, sb, n), c, n);
+        sb->length += n;
+    }
+}
+
+static void buffer_append(TeaState* T, FormatBuffer* sb, const char* s, int n)
+{
+    memcpy(buffer_need(T, sb, n), s, n);
+    sb->length += n;
+}
+
+static bool is_integer(double n)
+{
+    return n > -9.2e18 && n < 9.2e18 && n == floor(n);
+}
+
+static void check_arg(TeaState* T, TeaFormatSpec* spec, TeaValue* arg)
+{
+    switch(spec->type)
+    {
+        case 'd':
+        case 'x':
+        case 'X':
+            if(!IS_NUMBER(*arg) || !is_integer(AS_NUMBER(*arg)))
+                tea_error(T, "Format '%%%c' expects an integer, got %s", spec->type, tea_value_type(*arg));
+            break;
+        case 'f':
+        case 'e':
+        case 'g':
+            if(!IS_NUMBER(*arg))
+                tea_error(T, "Format '%%%c' expects a number, got %s", spec->type, tea_value_type(*arg));
+            break;
+        default:
+            if(!IS_STRING(*arg) && !IS_NUMBER(*arg))
+                *arg = OBJECT_VAL(tea_value_tostring(T, *arg));
+            break;
+    }
+}
+
+/* Formats a number argument into buf, returns its length */
+static int format_number(TeaFormatSpec* spec, double n, char* buf)
+{
+    char* p = buf;
+    if((spec->flags & STRFMT_F_PLUS) && !signbit(n))
+        *p++ = '+';
+
+    int precision = spec->precision;
+    switch(spec->type)
+    {
+        case 'd':
+            p += tea_strfmt_integer(p, (int64_t)n);
+            break;
+        case 'x':
+        case 'X':
+        {
+            int64_t i = (int64_t)n;
+            uint64_t u = i < 0 ? (uint64_t)0 - (uint64_t)i : (uint64_t)i;
+            p += snprintf(p, STRFMT_MAXBUF - 1, spec->type == 'x' ? "%s%llx" : "%s%llX", i < 0 ? "-" : "", (unsigned long long)u);
+            break;
+        }
+        case 'f':
+            p += snprintf(p, STRFMT_MAXBUF - 1, "%.*f", precision < 0 ? 6 : precision, n);
+            break;
+        case 'e':
+            p += snprintf(p, STRFMT_MAXBUF - 1, "%.*e", precision < 0 ? 6 : precision, n);
+            break;
+        case 'g':
+            if(precision >= 0)
+            {
+                p += snprintf(p, STRFMT_MAXBUF - 1, "%.*g", precision == 0 ? 1 : precision, n);
+                break;
+            }
+            /* fallthrough */
+        default:
+            p += tea_strfmt_number(p, n);
+            break;
+    }
+
+    return (int)(p - buf);
+}
+
+TeaObjectString* tea_strfmt_format(TeaState* T, TeaObjectString* fmt, TeaValue* args, int nargs)
+{
+    TeaFormat* format = fmt->format;
+    if(format == NULL)
+        format = tea_strfmt_parse(T, fmt);
+
+    if(format->nargs != nargs)
+        tea_error(T, "Expected %d format arguments, got %d", format->nargs, nargs);
+
+    /* Check and convert everything up front so nothing can throw once the buffer exists */
+    for(int i = 0; i < format->count; i++)
+    {
+        TeaFormatSpec* spec = &format->specs[i];
+        if(spec->arg >= 0)
+            check_arg(T, spec, &args[spec->arg]);
+    }
+
+    FormatBuffer sb = { NULL, 0, 0 };
+    buffer_need(T, &sb, fmt->length + nargs * 8);
+
+    char num[STRFMT_MAXBUF];
+    for(int i = 0; i < format->count; i++)
+    {
+        TeaFormatSpec* spec = &format->specs[i];
+        if(spec->arg < 0)
+        {
+            buffer_append(T, &sb, fmt->chars + spec->start, spec->length);
+            continue;
+        }
+
+        TeaValue arg = args[spec->arg];
+        const char* body;
+        int length, width;
+        bool zero = false;
+
+        if(IS_NUMBER(arg) && spec->type != 's')
+        {
+            body = num;
+            length = width = format_number(spec, AS_NUMBER(arg), num);
+            zero = (spec->flags & STRFMT_F_ZERO) && !(spec->flags & STRFMT_F_LEFT);
+        }
+        else
+        {
+            TeaObjectString* string;
+            if(IS_NUMBER(arg))
+            {
+                length = tea_strfmt_number(num, AS_NUMBER(arg));
+                string = NULL;
+                body = num;
+                width = length;
+            }
+            else
+            {
+                string = AS_STRING(arg);
+                body = string->chars;
+                length = string->length;
+                width = tea_utf_length(string);
+            }
+            if(spec->precision >= 0 && spec->precision < width)
+            {
+                length = string != NULL ? tea_utf_char_offset(T, string, spec->precision) : spec->precision;
+                width = spec->precision;
+            }
+        }
+
+        int pad = spec->width > width ? spec->width - width : 0;
+        if(spec->flags & STRFMT_F_LEFT)
+        {
+            buffer_append(T, &sb, body, length);
+            buffer_fill(T, &sb, ' ', pad);
+        }
+        else if(spec->flags & STRFMT_F_CENTER)
+        {
+            buffer_fill(T, &sb, ' ', pad / 2);
+            buffer_append(T, &sb, body, length);
+            buffer_fill(T, &sb, ' ', pad - pad / 2);
+        }
+        else if(zero)
+        {
+            /* Zeros go between the sign and the digits */
+            if(length > 0 && (body[0] == '-' || body[0] == '+'))
+            {
+                buffer_append(T, &sb, body, 1);
+                body++;
+                length--;
+            }
+            buffer_fill(T, &sb, '0', pad);
+            buffer_append(T, &sb, body, length);
+        }
+        else
+        {
+            buffer_fill(T, &sb, ' ', pad);
+            buffer_append(T, &sb, body, length);
+        }
+    }
+
+    sb.chars = TEA_SHRINK_ARRAY(T, char, sb.chars, sb.capacity, sb.length + 1);
+    sb.chars[sb.length] = '\0';
+
+    return tea_string_take(T, sb.chars, sb.length);
+}
@@ -0,0 +1,47 @@
+/*
+** tea_strfmt.h
+** Teascript number to string conversion
+*/
+
+#ifndef TEA_STRFMT_H
+#define TEA_STRFMT_H
+
+#include "tea_def.h"
+#include "tea_object.h"
+
+/* Enough for "-1.2345678901234567e-308" plus a terminator */
+#define STRFMT_MAXBUF_NUM 32
+
+/* Conversion flags */
+#define STRFMT_F_LEFT   0x01    /* '-' */
+#define STRFMT_F_ZERO   0x02    /* '0' */
+#define STRFMT_F_PLUS   0x04    /* '+' */
+#define STRFMT_F_CENTER 0x08    /* '^' */
+
+/* One literal run or conversion of a format string */
+typedef struct
+{
+    int start;          /* Byte range of a literal */
+    int length;
+    int arg;            /* Argument index, -1 for a literal */
+    int width;
+    int precision;      /* -1 when not given */
+    uint8_t flags;
+    char type;          /* 's', 'd', 'x', 'X', 'f', 'e' or 'g' */
+} TeaFormatSpec;
+
+typedef struct TeaFormat
+{
+    int count;
+    int nargs;
+    TeaFormatSpec specs[];
+} TeaFormat;
+
+int tea_strfmt_integer(char* buffer, int64_t n);
+int tea_strfmt_number(char* buffer, double n);
+
+TeaFormat* tea_strfmt_parse(TeaState* T, TeaObjectString* fmt);
+TeaObjectString* tea_strfmt_format(TeaState* T, TeaObjectString* fmt, TeaValue* args, int nargs);
+void tea_strfmt_free(TeaState* T, TeaObjectString* fmt);
+
+#endif
@@ -9,6 +9,7 @@
 #include "tea_string.h"
 #include "tea_state.h"
 #include "tea_vm.h"
+#include "tea_utf.h"
 
 static TeaObjectString* string_allocate(TeaState* T, char* chars, int length, uint32_t hash)
 {
@@ -16,6 +17,10 @@ static TeaObjectString* string_allocate(TeaState* T, char* chars, int length, ui
     string->length = length;
     string->chars = chars;
     string->hash = hash;
+    string->ascii = tea_utf_is_ascii(chars, length);
+    string->utf_length = string->ascii ? length : -1;
+    string->utf_index = NULL;
+    string->format = NULL;
 
     tea_vm_push(T, OBJECT_VAL(string));
     tea_table_set(T, &T->strings, string, NULL_VAL);
@@ -16,6 +16,7 @@
 #include "tea_core.h"
 #include "tea_utf.h"
 #include "tea_string.h"
+#include "tea_strfmt.h"
 
 static void string_len(TeaState* T)
 {
@@ -26,6 +27,16 @@ static void string_constructor(TeaState* T)
 {
     int count = tea_get_top(T);
     tea_ensure_min_args(T, count, 2);
+
+    /* The bytes of a buffer become the characters of the string */
+    if(tea_is_buffer(T, 1))
+    {
+        int len;
+        const char* bytes = tea_to_buffer(T, 1, &len);
+        tea_push_lstring(T, bytes, len);
+        return;
+    }
+
     const char* string = tea_to_string(T, 1);
     tea_pop(T, 1);
     tea_push_string(T, string);
@@ -162,10 +173,7 @@ static void string_split(TeaState* T)
         for(; index < len && list_len < max_split; index++) 
         {
             list_len++;
-            *(temp) = string[index];
-            *(temp + 1) = '\0';
-            
-            tea_push_string(T, temp);
+            tea_vm_push(T, OBJECT_VAL(tea_string_char(T, string[index])));
             tea_add_item(T, count);
         }
 
@@ -456,6 +464,14 @@ static void string_replace(TeaState* T)
     tea_vm_push(T, OBJECT_VAL(tea_string_take(T, result, result_size)));
 }
 
+static void string_format(TeaState* T)
+{
+    int count = tea_get_top(T);
+    TeaObjectString* fmt = AS_STRING(T->base[0]);
+
+    tea_vm_push(T, OBJECT_VAL(tea_strfmt_format(T, fmt, T->base + 1, count - 1)));
+}
+
 static void string_iterate(TeaState* T)
 {
     int count = tea_get_top(T);
@@ -523,6 +539,7 @@ static const TeaClass string_class[] = {
     { "count", "method", string_count },
     { "find", "method", string_find },
     { "replace", "method", string_replace },
+    { "format", "method", string_format },
     { "iterate", "method", string_iterate },
     { "iteratorvalue", "method", string_iteratorvalue },
     { NULL, NULL, NULL }
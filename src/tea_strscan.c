@@ -0,0 +1,164 @@
+/*
+** tea_strscan.c
+** Teascript string to number conversion
+**
+** Plain decimals with at most 19 significant digits whose mantissa and
+** power of ten are both exactly representable are converted with a single
+** correctly rounded multiply or divide (Clinger's fast path), everything
+** else goes through strtod
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#define tea_strscan_c
+#define TEA_CORE
+
+#include "tea_strscan.h"
+
+#define STRSCAN_MAXBUF 512
+
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool scan_isdigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool scan_fast(const char* p, const char* end, double* result)
+{
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+    bool any = false;
+
+    while(p < end && *p == '0')
+    {
+        p++;
+        any = true;
+    }
+    while(p < end && scan_isdigit(*p))
+    {
+        if(digits++ >= 19)
+            return false;
+        mantissa = mantissa * 10 + (uint64_t)(*p++ - '0');
+        any = true;
+    }
+    if(p < end && *p == '.')
+    {
+        p++;
+        if(digits == 0)
+        {
+            while(p < end && *p == '0')
+            {
+                p++;
+                exp10--;
+                any = true;
+            }
+        }
+        while(p < end && scan_isdigit(*p))
+        {
+            if(digits++ >= 19)
+                return false;
+            mantissa = mantissa * 10 + (uint64_t)(*p++ - '0');
+            exp10--;
+            any = true;
+        }
+    }
+    if(!any)
+        return false;
+
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool exp_negative = false;
+        if(p < end && (*p == '-' || *p == '+'))
+        {
+            exp_negative = *p == '-';
+            p++;
+        }
+        if(p == end || !scan_isdigit(*p))
+            return false;
+
+        int e = 0;
+        while(p < end && scan_isdigit(*p))
+        {
+            if(e > 9999)
+                return false;
+            e = e * 10 + (*p++ - '0');
+        }
+        exp10 += exp_negative ? -e : e;
+    }
+
+    if(p != end)
+        return false;
+    if(mantissa > (UINT64_C(1) << 53))
+        return false;
+
+    double d = (double)mantissa;
+    if(mantissa == 0)
+    {
+        exp10 = 0;
+    }
+    else if(exp10 < 0)
+    {
+        if(exp10 < -22)
+            return false;
+        d /= pow10_exact[-exp10];
+    }
+    else if(exp10 > 0)
+    {
+        if(exp10 > 22)
+            return false;
+        d *= pow10_exact[exp10];
+    }
+
+    *result = negative ? -d : d;
+    return true;
+}
+
+/* Converts exactly len bytes of s, returns false if they are not a valid number */
+bool tea_strscan_number(const char* s, int len, double* result)
+{
+    if(scan_fast(s, s + len, result))
+        return true;
+
+    /* The span need not be terminated, or even followed by a readable byte */
+    char buffer[STRSCAN_MAXBUF];
+    char* copy = NULL;
+    char* str = buffer;
+    if(len >= STRSCAN_MAXBUF)
+    {
+        copy = (char*)malloc(len + 1);
+        if(copy == NULL)
+            return false;
+        str = copy;
+    }
+    memcpy(str, s, len);
+    str[len] = '\0';
+
+    char* end;
+    int saved_errno = errno;
+    errno = 0;
+    double d = strtod(str, &end);
+    /* Underflow into the subnormal range still gives a usable result */
+    bool ok = end == str + len && (errno == 0 || (d != 0 && d != HUGE_VAL && d != -HUGE_VAL));
+
+    errno = saved_errno;
+    free(copy);
+    if(ok)
+        *result = d;
+    return ok;
+}
@@ -0,0 +1,13 @@
+/*
+** tea_strscan.h
+** Teascript string to number conversion
+*/
+
+#ifndef TEA_STRSCAN_H
+#define TEA_STRSCAN_H
+
+#include "tea_def.h"
+
+bool tea_strscan_number(const char* s, int len, double* result);
+
+#endif
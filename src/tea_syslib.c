@@ -24,10 +24,12 @@
 
 #include "tea_import.h"
 #include "tea_core.h"
+#include "tea_state.h"
 
 static void sys_exit(TeaState* T)
 {
     int count = tea_get_top(T);
+    tea_state_flush(T);
     count == 0 ? exit(1) : exit(tea_check_number(T, 0));
     tea_push_null(T);
 }
@@ -56,6 +58,22 @@ static void sys_sleep(TeaState* T)
     tea_push_null(T);
 }
 
+/* Occupancy of the string intern table */
+static void sys_strings(TeaState* T)
+{
+    TeaTable* strings = &T->strings;
+
+    tea_new_map(T);
+    tea_push_number(T, strings->count);
+    tea_set_key(T, -2, "count");
+    tea_push_number(T, strings->capacity);
+    tea_set_key(T, -2, "capacity");
+    tea_push_number(T, strings->tombstones);
+    tea_set_key(T, -2, "tombstones");
+    tea_push_number(T, tea_table_probe_length(strings));
+    tea_set_key(T, -2, "probe");
+}
+
 static void init_argv(TeaState* T)
 {
     int argc = T->argc;
@@ -100,6 +118,7 @@ static const char* byteorder()
 static const TeaModule sys_module[] = {
     { "sleep", sys_sleep },
     { "exit", sys_exit },
+    { "strings", sys_strings },
     { "argv", NULL },
     { "version", NULL },
     { "byteorder", NULL },
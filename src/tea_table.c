@@ -9,54 +9,143 @@
 #define tea_table_c
 #define TEA_CORE
 
+#include "tea_state.h"
 #include "tea_gc.h"
 #include "tea_memory.h"
 #include "tea_object.h"
 #include "tea_table.h"
 #include "tea_value.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CTRL_EMPTY ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xfe)
+/* Pads the control bytes of a table smaller than a group */
+#define CTRL_SENTINEL ((uint8_t)0xff)
+
+#define CTRL_IS_FULL(c) (((c) & 0x80) == 0)
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t)((hash) & 0x7f))
+
+typedef uint32_t GroupMask;
+
+/* Bit i set for every control byte in the group equal to h */
+static inline GroupMask group_match(const uint8_t* group, uint8_t h)
+{
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)h)));
+#else
+    GroupMask mask = 0;
+    for(int i = 0; i < TABLE_GROUP; i++)
+    {
+        if(group[i] == h)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+/* Bit i set for every empty or deleted slot in the group */
+static inline GroupMask group_match_free(const uint8_t* group)
+{
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (GroupMask)_mm_movemask_epi8(ctrl);
+#else
+    GroupMask mask = 0;
+    for(int i = 0; i < TABLE_GROUP; i++)
+    {
+        if(!CTRL_IS_FULL(group[i]))
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+static inline int mask_first(GroupMask mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while(!(mask & 1))
+    {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* A table smaller than a group is a single group with its tail padded */
+#define CTRL_SIZE(capacity) ((capacity) > 0 && (capacity) < TABLE_GROUP ? TABLE_GROUP : (capacity))
+#define GROUP_COUNT(capacity) ((capacity) < TABLE_GROUP ? 1 : (capacity) / TABLE_GROUP)
+#define SLOT_MASK(capacity) ((capacity) < TABLE_GROUP ? (1u << (capacity)) - 1 : 0xffffu)
+
+/* Triangular steps over a power of two group count visit every group */
+#define PROBE_START(hash, capacity) (H1(hash) & (GROUP_COUNT(capacity) - 1))
+#define PROBE_NEXT(group, step, capacity) (((group) + (step)) & (GROUP_COUNT(capacity) - 1))
+
 void tea_table_init(TeaTable* table)
 {
     table->count = 0;
+    table->tombstones = 0;
     table->capacity = 0;
+    table->ctrl = NULL;
     table->entries = NULL;
 }
 
 void tea_table_free(TeaState* T, TeaTable* table)
 {
     TEA_FREE_ARRAY(T, TeaEntry, table->entries, table->capacity);
+    TEA_FREE_ARRAY(T, uint8_t, table->ctrl, CTRL_SIZE(table->capacity));
     tea_table_init(table);
 }
 
-static TeaEntry* find_entry(TeaEntry* entries, int capacity, TeaObjectString* key)
+/* Returns the slot holding key, or -1 */
+static int find_slot(TeaTable* table, TeaObjectString* key)
 {
-    uint32_t index = key->hash & (capacity - 1);
-    TeaEntry* tombstone = NULL;
+    uint32_t hash = key->hash;
+    uint8_t h2 = H2(hash);
+    uint32_t group = PROBE_START(hash, table->capacity);
 
-    while(true)
+    for(uint32_t step = 1; ; step++)
     {
-        TeaEntry* entry = &entries[index];
-        if(entry->key == NULL)
-        {
-            if(IS_NULL(entry->value))
-            {
-                /* Empty entry */
-                return tombstone != NULL ? tombstone : entry;
-            }
-            else
-            {
-                /* We found a tombstone */
-                if(tombstone == NULL)
-                    tombstone = entry;
-            }
-        }
-        else if(entry->key == key)
+        const uint8_t* ctrl = &table->ctrl[group * TABLE_GROUP];
+        GroupMask mask = group_match(ctrl, h2);
+        while(mask != 0)
         {
-            /* We found the key */
-            return entry;
+            int slot = group * TABLE_GROUP + mask_first(mask);
+            if(table->entries[slot].key == key)
+                return slot;
+            mask &= mask - 1;
         }
 
-        index = (index + 1) & (capacity - 1);
+        /* A key is never placed past a group with an empty slot */
+        if(group_match(ctrl, CTRL_EMPTY) != 0)
+            return -1;
+
+        group = PROBE_NEXT(group, step, table->capacity);
+    }
+}
+
+/* First empty or deleted slot on the probe sequence of hash */
+static int find_free(uint8_t* ctrl, int capacity, uint32_t hash)
+{
+    uint32_t group = PROBE_START(hash, capacity);
+
+    for(uint32_t step = 1; ; step++)
+    {
+        /* The sentinel padding reads as free, so keep it out of the mask */
+        GroupMask mask = group_match_free(&ctrl[group * TABLE_GROUP]) & SLOT_MASK(capacity);
+        if(mask != 0)
+            return group * TABLE_GROUP + mask_first(mask);
+
+        group = PROBE_NEXT(group, step, capacity);
     }
 }
 
@@ -65,60 +154,100 @@ bool tea_table_get(TeaTable* table, TeaObjectString* key, TeaValue* value)
     if(table->count == 0)
         return false;
 
-    TeaEntry* entry = find_entry(table->entries, table->capacity, key);
-    if(entry->key == NULL)
+    int slot = find_slot(table, key);
+    if(slot < 0)
         return false;
 
-    *value = entry->value;
+    *value = table->entries[slot].value;
 
     return true;
 }
 
-static void adjust_capacity(TeaState* T, TeaTable* table, int capacity)
+static void rehash(TeaTable* table, uint8_t* ctrl, TeaEntry* entries, int capacity)
 {
-    TeaEntry* entries = TEA_ALLOCATE(T, TeaEntry, capacity);
-    for(int i = 0; i < capacity; i++)
-    {
-        entries[i].key = NULL;
-        entries[i].value = NULL_VAL;
-    }
+    memset(ctrl, CTRL_EMPTY, capacity);
+    memset(ctrl + capacity, CTRL_SENTINEL, CTRL_SIZE(capacity) - capacity);
 
-    table->count = 0;
     for(int i = 0; i < table->capacity; i++)
     {
-        TeaEntry *entry = &table->entries[i];
-        if(entry->key == NULL)
+        if(!CTRL_IS_FULL(table->ctrl[i]))
             continue;
 
-        TeaEntry* dest = find_entry(entries, capacity, entry->key);
-        dest->key = entry->key;
-        dest->value = entry->value;
-        table->count++;
+        TeaEntry* entry = &table->entries[i];
+        int slot = find_free(ctrl, capacity, entry->key->hash);
+        ctrl[slot] = H2(entry->key->hash);
+        entries[slot] = *entry;
     }
 
+    table->tombstones = 0;
+}
+
+static void adjust_capacity(TeaState* T, TeaTable* table, int capacity)
+{
+    TeaEntry* entries = TEA_ALLOCATE(T, TeaEntry, capacity);
+    uint8_t* ctrl = TEA_ALLOCATE(T, uint8_t, CTRL_SIZE(capacity));
+    rehash(table, ctrl, entries, capacity);
+
     TEA_FREE_ARRAY(T, TeaEntry, table->entries, table->capacity);
+    TEA_FREE_ARRAY(T, uint8_t, table->ctrl, CTRL_SIZE(table->capacity));
     table->entries = entries;
+    table->ctrl = ctrl;
     table->capacity = capacity;
 }
 
 bool tea_table_set(TeaState* T, TeaTable* table, TeaObjectString* key, TeaValue value)
 {
-    if(table->count + 1 > table->capacity * TABLE_MAX_LOAD)
+    if(table->count > 0)
     {
-        int capacity = TEA_GROW_CAPACITY(table->capacity);
-        adjust_capacity(T, table, capacity);
+        int slot = find_slot(table, key);
+        if(slot >= 0)
+        {
+            table->entries[slot].value = value;
+            return false;
+        }
     }
 
-    TeaEntry* entry = find_entry(table->entries, table->capacity, key);
-    bool is_new_key = entry->key == NULL;
+    if(table->count + table->tombstones + 1 > table->capacity * TABLE_MAX_LOAD)
+    {
+        /* Only grow if the live entries need it, otherwise just drop the tombstones */
+        int capacity = table->capacity < TABLE_MIN_CAPACITY ? TABLE_MIN_CAPACITY : table->capacity;
+        if(table->count + 1 > capacity * TABLE_MAX_LOAD / 2)
+            capacity = TEA_GROW_CAPACITY(capacity);
+        adjust_capacity(T, table, capacity);
+    }
 
-    if(is_new_key && IS_NULL(entry->value))
-        table->count++;
+    int slot = find_free(table->ctrl, table->capacity, key->hash);
+    if(table->ctrl[slot] == CTRL_DELETED)
+        table->tombstones--;
 
-    entry->key = key;
-    entry->value = value;
+    table->ctrl[slot] = H2(key->hash);
+    table->entries[slot].key = key;
+    table->entries[slot].value = value;
+    table->count++;
     
-    return is_new_key;
+    return true;
+}
+
+static void delete_slot(TeaTable* table, int slot)
+{
+    const uint8_t* group = &table->ctrl[slot & ~(TABLE_GROUP - 1)];
+
+    /*
+    ** Probes stop at a group with an empty slot, so if this group still
+    ** has one nothing can be probing past it and no tombstone is needed
+    */
+    if(group_match(group, CTRL_EMPTY) != 0)
+    {
+        table->ctrl[slot] = CTRL_EMPTY;
+    }
+    else
+    {
+        table->ctrl[slot] = CTRL_DELETED;
+        table->tombstones++;
+    }
+    table->entries[slot].key = NULL;
+    table->entries[slot].value = NULL_VAL;
+    table->count--;
 }
 
 bool tea_table_delete(TeaTable* table, TeaObjectString* key)
@@ -127,13 +256,11 @@ bool tea_table_delete(TeaTable* table, TeaObjectString* key)
         return false;
 
     /* Find the entry */
-    TeaEntry* entry = find_entry(table->entries, table->capacity, key);
-    if(entry->key == NULL)
+    int slot = find_slot(table, key);
+    if(slot < 0)
         return false;
 
-    /* Place a tombstone in the entry */
-    entry->key = NULL;
-    entry->value = BOOL_VAL(true);
+    delete_slot(table, slot);
 
     return true;
 }
@@ -142,9 +269,9 @@ void tea_table_add_all(TeaState* T, TeaTable* from, TeaTable* to)
 {
     for(int i = 0; i < from->capacity; i++)
     {
-        TeaEntry* entry = &from->entries[i];
-        if(entry->key != NULL)
+        if(CTRL_IS_FULL(from->ctrl[i]))
         {
+            TeaEntry* entry = &from->entries[i];
             tea_table_set(T, to, entry->key, entry->value);
         }
     }
@@ -155,44 +282,107 @@ TeaObjectString* tea_table_find_string(TeaTable* table, const char* chars, int l
     if(table->count == 0)
         return NULL;
 
-    uint32_t index = hash & (table->capacity - 1);
-    while(true)
+    uint8_t h2 = H2(hash);
+    uint32_t group = PROBE_START(hash, table->capacity);
+
+    for(uint32_t step = 1; ; step++)
     {
-        TeaEntry* entry = &table->entries[index];
-        if(entry->key == NULL)
-        {
-            /* Stop if we find an empty non-tombstone entry */
-            if (IS_NULL(entry->value))
-                return NULL;
-        }
-        else if(entry->key->length == length && entry->key->hash == hash && memcmp(entry->key->chars, chars, length) == 0)
+        const uint8_t* ctrl = &table->ctrl[group * TABLE_GROUP];
+        GroupMask mask = group_match(ctrl, h2);
+        while(mask != 0)
         {
-            /* We found it */
-            return entry->key;
+            TeaObjectString* key = table->entries[group * TABLE_GROUP + mask_first(mask)].key;
+            if(key->length == length && key->hash == hash && memcmp(key->chars, chars, length) == 0)
+            {
+                /* We found it */
+                return key;
+            }
+            mask &= mask - 1;
         }
 
-        index = (index + 1) & (table->capacity - 1);
+        /* Stop if the group has an empty slot */
+        if(group_match(ctrl, CTRL_EMPTY) != 0)
+            return NULL;
+
+        group = PROBE_NEXT(group, step, table->capacity);
     }
 }
 
-void tea_table_remove_white(TeaTable* table)
+void tea_table_remove_white(TeaState* T, TeaTable* table)
 {
     for(int i = 0; i < table->capacity; i++)
     {
-        TeaEntry* entry = &table->entries[i];
-        if(entry->key != NULL && !entry->key->obj.is_marked)
+        if(CTRL_IS_FULL(table->ctrl[i]) && !table->entries[i].key->obj.is_marked)
         {
-            tea_table_delete(table, entry->key);
+            delete_slot(table, i);
         }
     }
+
+    if(table->tombstones <= table->capacity * TABLE_MAX_TOMBSTONES)
+        return;
+
+    /* Rebuild at the smallest size that keeps the load under half */
+    int capacity = TABLE_MIN_CAPACITY;
+    while(table->count > capacity * TABLE_MAX_LOAD / 2)
+        capacity *= 2;
+
+    /*
+    ** This runs in the middle of a collection, so allocate directly
+    ** instead of through tea_mem_realloc, which could start another one
+    */
+    TeaEntry* entries = (TeaEntry*)(*T->frealloc)(T->ud, NULL, 0, sizeof(TeaEntry) * capacity);
+    if(entries == NULL)
+        return;
+    uint8_t* ctrl = (uint8_t*)(*T->frealloc)(T->ud, NULL, 0, CTRL_SIZE(capacity));
+    if(ctrl == NULL)
+    {
+        (*T->frealloc)(T->ud, entries, sizeof(TeaEntry) * capacity, 0);
+        return;
+    }
+    T->bytes_allocated += sizeof(TeaEntry) * capacity + CTRL_SIZE(capacity);
+    rehash(table, ctrl, entries, capacity);
+
+    TEA_FREE_ARRAY(T, TeaEntry, table->entries, table->capacity);
+    TEA_FREE_ARRAY(T, uint8_t, table->ctrl, CTRL_SIZE(table->capacity));
+    table->entries = entries;
+    table->ctrl = ctrl;
+    table->capacity = capacity;
 }
 
 void tea_table_mark(TeaState* T, TeaTable* table)
 {
     for(int i = 0; i < table->capacity; i++)
     {
+        if(!CTRL_IS_FULL(table->ctrl[i]))
+            continue;
+
         TeaEntry* entry = &table->entries[i];
         tea_gc_mark_object(T, (TeaObject*)entry->key);
         tea_gc_mark_value(T, entry->value);
     }
-}
\ No newline at end of file
+}
+
+/* Average number of groups inspected to find a live key */
+double tea_table_probe_length(TeaTable* table)
+{
+    if(table->count == 0)
+        return 0;
+
+    uint64_t total = 0;
+    for(int i = 0; i < table->capacity; i++)
+    {
+        if(!CTRL_IS_FULL(table->ctrl[i]))
+            continue;
+
+        uint32_t target = i / TABLE_GROUP;
+        uint32_t group = PROBE_START(table->entries[i].key->hash, table->capacity);
+        for(uint32_t step = 1; group != target; step++)
+        {
+            group = PROBE_NEXT(group, step, table->capacity);
+            total++;
+        }
+        total++;
+    }
+
+    return (double)total / table->count;
+}
@@ -11,16 +11,30 @@
 
 #define TABLE_MAX_LOAD 0.75
 
+/* Slots are probed a group at a time, one control byte per slot */
+#define TABLE_GROUP 16
+
+/*
+** Most instance field tables hold a handful of entries, so a table starts
+** below one group; its control bytes are still padded out to TABLE_GROUP
+*/
+#define TABLE_MIN_CAPACITY 4
+
 typedef struct
 {
     TeaObjectString* key;
     TeaValue value;
 } TeaEntry;
 
+/* Rebuild once more than this fraction of the slots are tombstones */
+#define TABLE_MAX_TOMBSTONES 0.25
+
 typedef struct
 {
-    int count;
-    int capacity;
+    int count;          /* Live entries */
+    int tombstones;
+    int capacity;       /* A power of two, at least TABLE_MIN_CAPACITY */
+    uint8_t* ctrl;      /* Low 7 hash bits of a live slot, or CTRL_EMPTY/CTRL_DELETED */
     TeaEntry* entries;
 } TeaTable;
 
@@ -32,7 +46,9 @@ bool tea_table_delete(TeaTable* table, TeaObjectString* key);
 void tea_table_add_all(TeaState* T, TeaTable* from, TeaTable* to);
 TeaObjectString* tea_table_find_string(TeaTable* table, const char* chars, int length, uint32_t hash);
 
-void tea_table_remove_white(TeaTable* table);
+void tea_table_remove_white(TeaState* T, TeaTable* table);
 void tea_table_mark(TeaState* T, TeaTable* table);
 
+double tea_table_probe_length(TeaTable* table);
+
 #endif
\ No newline at end of file
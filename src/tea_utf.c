@@ -3,12 +3,20 @@
 ** UTF-8 functions for Teascript
 */
 
+#include <string.h>
+
 #define tea_utf_c
 #define TEA_CORE
 
 #include "tea_utf.h"
 #include "tea_object.h"
+#include "tea_state.h"
 #include "tea_string.h"
+#include "tea_memory.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 int tea_utf_decode_bytes(uint8_t byte)
 {
@@ -60,16 +68,61 @@ int tea_utf_encode_bytes(int value)
 	return 0;
 }
 
+bool tea_utf_is_ascii(const char* chars, int length)
+{
+	int i = 0;
+
+#if defined(__SSE2__)
+	for(; i + 16 <= length; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(chars + i));
+		if(_mm_movemask_epi8(chunk) != 0)
+			return false;
+	}
+#endif
+
+	for(; i + 8 <= length; i += 8)
+	{
+		uint64_t chunk;
+		memcpy(&chunk, chars + i, sizeof(uint64_t));
+		if(chunk & UINT64_C(0x8080808080808080))
+			return false;
+	}
+
+	for(; i < length; i++)
+	{
+		if((uint8_t)chars[i] & 0x80)
+			return false;
+	}
+
+	return true;
+}
+
+/* Bytes taken by the codepoint starting at i, stray continuation bytes count as one */
+static int utf_advance(TeaObjectString* string, int i)
+{
+	int n = tea_utf_decode_bytes(string->chars[i]);
+	if(n == 0)
+		return 1;
+	return n;
+}
+
 int tea_utf_length(TeaObjectString* string)
 {
+	if(string->utf_length >= 0)
+	{
+		return string->utf_length;
+	}
+
 	int length = 0;
 
-	for(uint32_t i = 0; i < string->length;) 
+	for(int i = 0; i < string->length;) 
     {
-		i += tea_utf_decode_bytes(string->chars[i]);
+		i += utf_advance(string, i);
 		length++;
 	}
 
+	string->utf_length = length;
 	return length;
 }
 
@@ -175,12 +228,7 @@ TeaObjectString* tea_utf_codepoint_at(TeaState* T, TeaObjectString* string, uint
 
 	if(code_point == -1) 
     {
-		char bytes[2];
-
-		bytes[0] = string->chars[index];
-		bytes[1] = '\0';
-
-		return tea_string_copy(T, bytes, 1);
+		return tea_string_char(T, string->chars[index]);
 	}
 
 	return tea_utf_from_codepoint(T, code_point);
@@ -188,6 +236,11 @@ TeaObjectString* tea_utf_codepoint_at(TeaState* T, TeaObjectString* string, uint
 
 TeaObjectString* tea_utf_from_codepoint(TeaState* T, int value) 
 {
+	if(value >= 0 && value <= 0x7f)
+	{
+		return tea_string_char(T, value);
+	}
+
 	int length = tea_utf_encode_bytes(value);
 	char* bytes = TEA_ALLOCATE(T, char, length + 1);
 	bytes[length] = '\0';
@@ -207,6 +260,11 @@ TeaObjectString* tea_utf_from_range(TeaState* T, TeaObjectString* source, int st
 		length += tea_utf_decode_bytes(from[start + i * step]);
 	}
 
+	if(count == 1 && length == 1)
+	{
+		return tea_string_char(T, from[start]);
+	}
+
 	char* bytes = TEA_ALLOCATE(T, char, length + 1);
 	bytes[length] = '\0';
 
@@ -226,17 +284,55 @@ TeaObjectString* tea_utf_from_range(TeaState* T, TeaObjectString* source, int st
 	return tea_string_take(T, bytes, length);
 }
 
-int tea_utf_char_offset(char* str, int index) 
+static void build_index(TeaState* T, TeaObjectString* string)
 {
-	#define is_utf(c) (((c) & 0xC0) != 0x80)
-	int offset = 0;
+	int length = tea_utf_length(string);
+	uint32_t* index = TEA_ALLOCATE(T, uint32_t, length / TEA_UTF_INDEX_STRIDE + 1);
 
-	while(index > 0 && str[offset]) 
+	int count = 0;
+	for(int i = 0; i < string->length; count++) 
     {
-		(void)(is_utf(str[++offset]) || is_utf(str[++offset]) || is_utf(str[++offset]) || ++offset);
-		index--;
+		if(count % TEA_UTF_INDEX_STRIDE == 0)
+		{
+			index[count / TEA_UTF_INDEX_STRIDE] = i;
+		}
+		i += utf_advance(string, i);
+	}
+	if(count % TEA_UTF_INDEX_STRIDE == 0)
+	{
+		index[count / TEA_UTF_INDEX_STRIDE] = string->length;
+	}
+
+	string->utf_index = index;
+}
+
+/* Byte offset of the codepoint at index, which must be within the string */
+int tea_utf_char_offset(TeaState* T, TeaObjectString* string, int index) 
+{
+	if(string->ascii)
+	{
+		return index;
+	}
+
+	if(string->utf_index == NULL)
+	{
+		build_index(T, string);
+	}
+
+	int offset = string->utf_index[index / TEA_UTF_INDEX_STRIDE];
+	for(int i = index % TEA_UTF_INDEX_STRIDE; i > 0; i--)
+	{
+		offset += utf_advance(string, offset);
 	}
 
 	return offset;
-	#undef is_utf
-}
\ No newline at end of file
+}
+
+void tea_utf_free_index(TeaState* T, TeaObjectString* string)
+{
+	if(string->utf_index != NULL)
+	{
+		TEA_FREE_ARRAY(T, uint32_t, string->utf_index, string->utf_length / TEA_UTF_INDEX_STRIDE + 1);
+		string->utf_index = NULL;
+	}
+}
@@ -12,6 +12,11 @@
 int tea_utf_decode_bytes(uint8_t byte);
 int tea_utf_encode_bytes(int value);
 
+/* Codepoints between two entries of a string's sparse offset index */
+#define TEA_UTF_INDEX_STRIDE 32
+
+bool tea_utf_is_ascii(const char* chars, int length);
+
 int tea_utf_length(TeaObjectString* string);
 int tea_utf_decode(const uint8_t* bytes, uint32_t length);
 int tea_utf_encode(int value, uint8_t* bytes);
@@ -20,6 +25,7 @@ TeaObjectString* tea_utf_codepoint_at(TeaState* T, TeaObjectString* string, uint
 TeaObjectString* tea_utf_from_codepoint(TeaState* T, int value);
 TeaObjectString* tea_utf_from_range(TeaState* T, TeaObjectString* source, int start, uint32_t count, int step);
 
-int tea_utf_char_offset(char* str, int index);
+int tea_utf_char_offset(TeaState* T, TeaObjectString* string, int index);
+void tea_utf_free_index(TeaState* T, TeaObjectString* string);
 
 #endif
\ No newline at end of file
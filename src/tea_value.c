@@ -6,23 +6,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <errno.h>
 #include <math.h>
 
 #define tea_value_c
 #define TEA_CORE
 
 #include "tea_object.h"
+#include "tea_state.h"
 #include "tea_string.h"
 #include "tea_memory.h"
 #include "tea_value.h"
+#include "tea_strfmt.h"
+#include "tea_strscan.h"
 
 DEFINE_ARRAY(TeaValueArray, TeaValue, value_array)
 DEFINE_ARRAY(TeaBytes, uint8_t, bytes)
 
+/* In TeaType order */
 const char* const tea_value_typenames[] = {
     "null", "number", "bool", 
-    "userdata", "string", "range", "function", "module", "class", "instance", "list", "map", "file"
+    "string", "range", "function", "module", "class", "instance", "list", "map", "set", "iterator", "buffer", "file", "userdata"
 };
 
 const char* tea_value_type(TeaValue a)
@@ -107,13 +110,10 @@ double tea_value_tonumber(TeaValue value, int* x)
     }
     else if(IS_STRING(value))
     {
-        char* n = AS_CSTRING(value);
-        char* end;
-        errno = 0;
+        TeaObjectString* string = AS_STRING(value);
+        double number;
 
-        double number = strtod(n, &end);
-
-        if(errno != 0 || *end != '\0')
+        if(!tea_strscan_number(string->chars, string->length, &number))
         {
             if(x != NULL)
                 *x = false;
@@ -181,9 +181,21 @@ TeaObjectString* tea_value_number_tostring(TeaState* T, double number)
         }
     }
 
-    int length = snprintf(NULL, 0, TEA_NUMBER_FMT, number);
-    char* string = TEA_ALLOCATE(T, char, length + 1);
-    snprintf(string, length + 1, TEA_NUMBER_FMT, number);
+    /* Small non-negative integers are cached on the state */
+    int cache = -1;
+    if(number >= 0 && number < NUMBER_CACHE_SIZE && number == (int)number && !signbit(number))
+    {
+        cache = (int)number;
+        if(T->number_strings[cache] != NULL)
+            return T->number_strings[cache];
+    }
+
+    char buffer[STRFMT_MAXBUF_NUM];
+    int length = tea_strfmt_number(buffer, number);
+
+    TeaObjectString* result = tea_string_copy(T, buffer, length);
+    if(cache != -1)
+        T->number_strings[cache] = result;
 
-    return tea_string_take(T, string, length);
+    return result;
 }
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include "tea_object.h"
 #include "tea_func.h"
 #include "tea_map.h"
+#include "tea_set.h"
 #include "tea_string.h"
 #include "tea_memory.h"
 #include "tea_vm.h"
@@ -206,6 +207,14 @@ static void in_(TeaState* T, TeaValue object, TeaValue value)
                 tea_vm_push(T, BOOL_VAL(tea_map_get(map, value, &_)));
                 return;
             }
+            case OBJ_SET:
+            {
+                TeaObjectSet* set = AS_SET(object);
+
+                tea_vm_pop(T, 2);
+                tea_vm_push(T, BOOL_VAL(tea_set_contains(set, value)));
+                return;
+            }
             default:
                 break;
         }
@@ -276,14 +285,36 @@ static void subscript(TeaState* T, TeaValue index_value, TeaValue subscript_valu
 
             tea_vm_error(T, "List index out of bounds");
         }
-        case OBJ_MAP:
+        case OBJ_BUFFER:
         {
-            TeaObjectMap* map = AS_MAP(subscript_value);
-            if(!tea_map_validkey(index_value))
+            if(!IS_NUMBER(index_value)) 
+            {
+                tea_vm_error(T, "Buffer index must be a number");
+            }
+
+            TeaObjectBuffer* buffer = AS_BUFFER(subscript_value);
+            int index = AS_NUMBER(index_value);
+
+            /* Allow negative indexes */
+            if(index < 0)
             {
-                tea_vm_error(T, "Map key isn't hashable");
+                index = buffer->length + index;
             }
 
+            if(index >= 0 && index < buffer->length) 
+            {
+                uint8_t byte = tea_obj_buffer_bytes(T, buffer)[index];
+                tea_vm_pop(T, 2);
+                tea_vm_push(T, NUMBER_VAL(byte));
+                return;
+            }
+
+            tea_vm_error(T, "Buffer index out of bounds");
+        }
+        case OBJ_MAP:
+        {
+            TeaObjectMap* map = AS_MAP(subscript_value);
+
             TeaValue value;
             tea_vm_pop(T, 2);
             if(tea_map_get(map, index_value, &value))
@@ -311,10 +342,10 @@ static void subscript(TeaState* T, TeaValue index_value, TeaValue subscript_valu
                 index = real_length + index;
             }
 
-            if(index >= 0 && index < string->length)
+            if(index >= 0 && index < real_length)
             {
+                TeaObjectString* c = tea_utf_codepoint_at(T, string, tea_utf_char_offset(T, string, index));
                 tea_vm_pop(T, 2);
-                TeaObjectString* c = tea_utf_codepoint_at(T, string, tea_utf_char_offset(string->chars, index));
                 tea_vm_push(T, OBJECT_VAL(c));
                 return;
             }
@@ -370,14 +401,48 @@ static void subscript_store(TeaState* T, TeaValue item_value, TeaValue index_val
 
             tea_vm_error(T, "List index out of bounds");
         }
-        case OBJ_MAP:
+        case OBJ_BUFFER:
         {
-            TeaObjectMap* map = AS_MAP(subscript_value);
-            if(!tea_map_validkey(index_value))
+            if(!IS_NUMBER(index_value)) 
             {
-                tea_vm_error(T, "Map key isn't hashable");
+                tea_vm_error(T, "Buffer index must be a number (got %s)", tea_value_type(index_value));
             }
 
+            TeaObjectBuffer* buffer = AS_BUFFER(subscript_value);
+            int index = AS_NUMBER(index_value);
+
+            if(index < 0)
+            {
+                index = buffer->length + index;
+            }
+
+            if(index < 0 || index >= buffer->length) 
+            {
+                tea_vm_error(T, "Buffer index out of bounds");
+            }
+
+            uint8_t* bytes = tea_obj_buffer_bytes(T, buffer);
+            if(assign)
+            {
+                if(!IS_NUMBER(item_value) || AS_NUMBER(item_value) < 0 || AS_NUMBER(item_value) > 255)
+                {
+                    tea_vm_error(T, "Buffer items must be bytes from 0 to 255");
+                }
+                bytes[index] = (uint8_t)AS_NUMBER(item_value);
+                tea_vm_pop(T, 3);
+                tea_vm_push(T, item_value);
+            }
+            else
+            {
+                T->top[-1] = NUMBER_VAL(bytes[index]);
+                tea_vm_push(T, item_value);
+            }
+            return;
+        }
+        case OBJ_MAP:
+        {
+            TeaObjectMap* map = AS_MAP(subscript_value);
+
             if(assign)
             {
                 tea_map_set(T, map, index_value, item_value);
@@ -818,10 +883,12 @@ void tea_vm_run(TeaState* T)
                     tea_table_set(T, &T->globals, T->repl_string, value);
                     TeaObjectString* string = tea_value_tostring(T, value);
                     PUSH(OBJECT_VAL(string));
-                    fwrite(string->chars, sizeof(char), string->length, stdout);
-                    putchar('\n');
+                    tea_state_write(T, string->chars, string->length);
+                    tea_state_write(T, "\n", 1);
                     DROP(1);
                 }
+                /* Everything printed comes out ahead of the next prompt */
+                tea_state_flush(T);
                 DROP(1);
                 DISPATCH();
             }
@@ -995,6 +1062,7 @@ void tea_vm_run(TeaState* T)
                 TeaObjectList* list = tea_obj_new_list(T);
 
                 PUSH(OBJECT_VAL(list));
+                tea_reserve_value_array(T, &list->items, item_count);
 
                 /* Add items to list */
                 for(int i = item_count; i > 0; i--)
@@ -1111,11 +1179,6 @@ void tea_vm_run(TeaState* T)
 
                 for(int i = item_count * 2; i > 0; i -= 2)
                 {
-                    if(!tea_map_validkey(PEEK(i)))
-                    {
-                        RUNTIME_ERROR("Map key isn't hashable");
-                    }
-
                     tea_map_set(T, map, PEEK(i), PEEK(i - 1));
                 }
 
@@ -1233,10 +1296,7 @@ void tea_vm_run(TeaState* T)
                     TeaObjectList* l2 = AS_LIST(PEEK(0));
                     TeaObjectList* l1 = AS_LIST(PEEK(1));
 
-                    for(int i = 0; i < l2->items.count; i++)
-                    {
-                        tea_write_value_array(T, &l1->items, l2->items.values[i]);
-                    }
+                    tea_append_value_array(T, &l1->items, &l2->items);
 
                     DROP(2);
 
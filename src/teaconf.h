@@ -25,8 +25,22 @@
 
 #define TEAMOD_API  TEA_API
 
-#ifndef TEA_NUMBER_FMT
-#define TEA_NUMBER_FMT		"%.16g"
+#if defined(TEA_USE_LINUX) || defined(TEA_USE_MACOSX)
+#define TEA_USE_POSIX
+#endif
+
+#if defined(TEA_USE_LINUX)
+#define TEA_USE_EPOLL
+#endif
+
+/* Number and string lists at least this long are sorted on several threads */
+#ifndef TEA_SORT_PARALLEL_MIN
+#define TEA_SORT_PARALLEL_MIN	200000
+#endif
+
+/* Threads used by parallel sorts, 0 uses one per online processor */
+#ifndef TEA_SORT_THREADS
+#define TEA_SORT_THREADS	0
 #endif
 
 #endif
\ No newline at end of file
@@ -21,4 +21,16 @@ TEAMOD_API void tea_import_io(TeaState* T);
 #define TEA_RANDOM_MODULE "random"
 TEAMOD_API void tea_import_random(TeaState* T);
 
+#define TEA_EVENT_MODULE "event"
+TEAMOD_API void tea_import_event(TeaState* T);
+
+#define TEA_SOCKET_MODULE "socket"
+TEAMOD_API void tea_import_socket(TeaState* T);
+
+#define TEA_JSON_MODULE "json"
+TEAMOD_API void tea_import_json(TeaState* T);
+
+#define TEA_CSV_MODULE "csv"
+TEAMOD_API void tea_import_csv(TeaState* T);
+
 #endif
\ No newline at end of file